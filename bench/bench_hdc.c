@@ -0,0 +1,388 @@
+#define _POSIX_C_SOURCE 199309L
+#include "../lib/hdc.c" /* needed to benchmark static kernels */
+#include "../test/hdc_dataset.h"
+#include <time.h>
+
+#define BENCH_D 10000
+#define BENCH_N 4
+#define BENCH_MAXL 21
+#define BENCH_CLASSES 5
+#define BENCH_SAMPLES 2000
+
+static unsigned int bench_seed = 12345;
+
+/**
+ * Returns a pseudo-random integer independent of rand(), which the library
+ * reseeds when it builds item memories.
+ * @return Random integer in [0, 32767]
+ */
+static int bench_rand(void)
+{
+    bench_seed = bench_seed * 1103515245u + 12345u;
+    return (int)((bench_seed >> 16) & 0x7fff);
+}
+
+/**
+ * Returns the current monotonic time in seconds.
+ */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Times quantize_block on SAMPLES, whose rows are one contiguous block, and
+ * on a copy of them with every row allocated on its own.
+ * @param levels      Destination for BENCH_SAMPLES rows of level indices
+ * @param samples     BENCH_SAMPLES contiguous rows of NUM_EMG_CHANNELS
+ * @param cim_length  Length of the continuous item memory
+ */
+static void bench_quantize(hdc_level_t levels[], double** samples,
+                           int cim_length)
+{
+    int repeats = 100;
+    double** rows = malloc(BENCH_SAMPLES * sizeof(double*));
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        rows[i] = malloc(NUM_EMG_CHANNELS * sizeof(double));
+        memcpy(rows[i], samples[i], NUM_EMG_CHANNELS * sizeof(double));
+    }
+
+    double start = now();
+    for (int r = 0; r < repeats; r++)
+    {
+        quantize_block(levels, samples, BENCH_SAMPLES, NUM_EMG_CHANNELS, 1.0,
+                       cim_length);
+    }
+    double contiguous_ns = (now() - start) * 1e9 / repeats / BENCH_SAMPLES;
+    start = now();
+    for (int r = 0; r < repeats; r++)
+    {
+        quantize_block(levels, rows, BENCH_SAMPLES, NUM_EMG_CHANNELS, 1.0,
+                       cim_length);
+    }
+    double rows_ns = (now() - start) * 1e9 / repeats / BENCH_SAMPLES;
+    printf("quantize_block:      %10.1f ns/sample contiguous, %.1f ns/sample "
+           "by row\n", contiguous_ns, rows_ns);
+
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        free(rows[i]);
+    }
+    free(rows);
+}
+
+/**
+ * Times one train-style step (ngram, similarity, bundle) and one
+ * predict-style search over all classes per window with KERNELS.
+ * @return Nanoseconds per window
+ */
+static double bench_kernels(const struct hdc_kernels* kernels,
+                            struct hdc_trained_model* model,
+                            hdc_level_t levels[], int len)
+{
+    double* ngram = malloc(BENCH_D * sizeof(double));
+    double* record = malloc(BENCH_D * sizeof(double));
+    double* accum = calloc(BENCH_D, sizeof(double));
+    double sink = 0.0;
+
+    double start = now();
+    for (int i = 0; i < len - BENCH_N + 1; i++)
+    {
+        kernels->ngram(ngram, record, levels + i * NUM_EMG_CHANNELS,
+                       model->item_memories, BENCH_D, BENCH_N);
+        for (int label = 0; label < model->num_classes; label++)
+        {
+            sink += kernels->similarity(model->am[label], ngram, BENCH_D);
+        }
+        kernels->bundle(accum, accum, ngram, BENCH_D);
+    }
+    double elapsed = now() - start;
+
+    if (sink == 0.0) printf("\n"); /* keep the search from being elided */
+    free(accum);
+    free(record);
+    free(ngram);
+    return elapsed * 1e9 / (len - BENCH_N + 1);
+}
+
+/**
+ * Reports accuracy, size and search time of compressed variants of MODEL
+ * against the full-precision associative memory.
+ */
+static void bench_compression(struct hdc_trained_model* model, int labels[],
+                              double** samples, hdc_level_t levels[], int len)
+{
+    static const int bits[] = { 1, 2, 4, 1, 2 };
+    static const double keep[] = { 1.0, 1.0, 1.0, 0.5, 0.25 };
+    const struct hdc_kernels* kernels =
+        select_kernels(BENCH_D, BENCH_N, NUM_EMG_CHANNELS);
+    int num_queries = len - BENCH_N + 1;
+    double* queries = malloc((size_t)num_queries * BENCH_D * sizeof(double));
+    double* record = malloc(BENCH_D * sizeof(double));
+    for (int i = 0; i < num_queries; i++)
+    {
+        kernels->ngram(queries + (size_t)i * BENCH_D, record,
+                       levels + i * NUM_EMG_CHANNELS, model->item_memories,
+                       BENCH_D, BENCH_N);
+    }
+
+    int sink = 0;
+    double start = now();
+    for (int i = 0; i < num_queries; i++)
+    {
+        double max_angle = -1;
+        for (int label = 0; label < model->num_classes; label++)
+        {
+            double angle = kernels->similarity(model->am[label],
+                                               queries + (size_t)i * BENCH_D,
+                                               BENCH_D);
+            if (angle > max_angle)
+            {
+                max_angle = angle;
+                sink += label;
+            }
+        }
+    }
+    double full_ns = (now() - start) * 1e9 / num_queries;
+    printf("full AM:        %8zu bytes, %8.0f ns/search\n",
+           (size_t)model->num_classes * BENCH_D * sizeof(double), full_ns);
+
+    for (int c = 0; c < (int)(sizeof(bits) / sizeof(bits[0])); c++)
+    {
+        struct hdc_compressed_model* compressed =
+            hdccompress(model, BENCH_D, bits[c], keep[c]);
+        struct hdc_accuracy accuracy =
+            hdcpredict_compressed(compressed, labels, samples, len, BENCH_N,
+                                  1.0);
+        uint64_t* packed = malloc((size_t)num_queries * compressed->words
+                                  * sizeof(uint64_t));
+        for (int i = 0; i < num_queries; i++)
+        {
+            pack_signs(packed + (size_t)i * compressed->words,
+                       queries + (size_t)i * BENCH_D, compressed);
+        }
+        struct hdc_prediction prediction;
+        start = now();
+        for (int i = 0; i < num_queries; i++)
+        {
+            sink += search_compressed(compressed,
+                                      packed + (size_t)i * compressed->words,
+                                      1, &prediction);
+        }
+        double ns = (now() - start) * 1e9 / num_queries;
+        printf("bits=%d keep=%.2f: %8zu bytes, %8.0f ns/search (%.1fx), "
+               "accuracy %.4f\n", bits[c], keep[c], compressed->bytes, ns,
+               full_ns / ns, accuracy.accuracy);
+        free(packed);
+        hdcdeinit_compressed(compressed);
+    }
+
+    if (sink == 0) printf("\n"); /* keep the search from being elided */
+    free(record);
+    free(queries);
+}
+
+/**
+ * Builds a binarized compressed model of NUM_CLASSES random class vectors
+ * without training, so that large class counts are cheap to set up.
+ */
+static struct hdc_compressed_model* random_compressed_model(int num_classes)
+{
+    struct hdc_compressed_model* model =
+        calloc(1, sizeof(struct hdc_compressed_model));
+    model->num_classes = num_classes;
+    model->D = BENCH_D;
+    model->num_dims = BENCH_D;
+    model->bits = 1;
+    model->words = (BENCH_D + 63) / 64;
+    model->dims = malloc(BENCH_D * sizeof(int));
+    model->planes = calloc((size_t)num_classes * model->words,
+                           sizeof(uint64_t));
+    model->norms = malloc(num_classes * sizeof(double));
+    for (int d = 0; d < BENCH_D; d++)
+    {
+        model->dims[d] = d;
+    }
+    for (int c = 0; c < num_classes; c++)
+    {
+        for (int j = 0; j < BENCH_D; j++)
+        {
+            if (bench_rand() & 1)
+            {
+                model->planes[(size_t)c * model->words + j / 64] |=
+                    (uint64_t)1 << (j % 64);
+            }
+        }
+        model->norms[c] = sqrt((double)BENCH_D);
+    }
+    return model;
+}
+
+/**
+ * Compares linear and indexed search latency and recall as the number of
+ * classes grows. Queries are class vectors with 30% of their bits flipped.
+ */
+static void bench_index(void)
+{
+    static const int class_counts[] = { 256, 1024, 4096, 16384 };
+    static const int nprobes[] = { 2, 8 };
+    const int num_queries = 200;
+
+    for (int n = 0; n < (int)(sizeof(class_counts) / sizeof(int)); n++)
+    {
+        int num_classes = class_counts[n];
+        struct hdc_compressed_model* model =
+            random_compressed_model(num_classes);
+        int words = model->words;
+        uint64_t* queries = malloc((size_t)num_queries * words
+                                   * sizeof(uint64_t));
+        int* expected = malloc(num_queries * sizeof(int));
+        for (int q = 0; q < num_queries; q++)
+        {
+            int label = bench_rand() % num_classes;
+            uint64_t* query = queries + (size_t)q * words;
+            memcpy(query, model->planes + (size_t)label * words,
+                   words * sizeof(uint64_t));
+            for (int j = 0; j < BENCH_D; j++)
+            {
+                if (bench_rand() % 10 < 3)
+                {
+                    query[j / 64] ^= (uint64_t)1 << (j % 64);
+                }
+            }
+        }
+
+        struct hdc_prediction prediction;
+        double start = now();
+        for (int q = 0; q < num_queries; q++)
+        {
+            expected[q] = search_compressed(model, queries + (size_t)q * words,
+                                            1, &prediction);
+        }
+        double linear_ns = (now() - start) * 1e9 / num_queries;
+        printf("classes=%5d linear:        %10.0f ns/search\n", num_classes,
+               linear_ns);
+
+        int num_lists = (int)sqrt((double)num_classes);
+        struct hdc_am_index* index = hdcindex(model, num_lists, 5);
+        int* probes = malloc(num_lists * sizeof(int));
+        int* distances = malloc(num_lists * sizeof(int));
+        for (int p = 0; p < (int)(sizeof(nprobes) / sizeof(int)); p++)
+        {
+            int hits = 0;
+            start = now();
+            for (int q = 0; q < num_queries; q++)
+            {
+                hits += search_index(index, queries + (size_t)q * words,
+                                     nprobes[p], probes, distances, 1,
+                                     &prediction)
+                    == expected[q];
+            }
+            double ns = (now() - start) * 1e9 / num_queries;
+            printf("classes=%5d index nprobe=%d: %10.0f ns/search (%.1fx), "
+                   "recall %.3f\n", num_classes, nprobes[p], ns,
+                   linear_ns / ns, (double)hits / num_queries);
+        }
+
+        free(distances);
+        free(probes);
+        hdcdeinit_index(index);
+        free(expected);
+        free(queries);
+        hdcdeinit_compressed(model);
+    }
+}
+
+/**
+ * Compares dense and block-sparse models on the synthetic data set.
+ */
+static void bench_sparse(int labels[], double** samples, int len,
+                         double dense_train, double dense_predict)
+{
+    static const int block_sizes[] = { 40, 100 };
+    /* Bytes of the query and the class vector read by one similarity */
+    printf("dense:  D=%5d %8.2f ms train, %8.2f ms predict, %6zu bytes "
+           "read per similarity\n", BENCH_D, dense_train * 1e3,
+           dense_predict * 1e3, 2 * BENCH_D * sizeof(double));
+    for (int s = 0; s < (int)(sizeof(block_sizes) / sizeof(int)); s++)
+    {
+        int blocks = BENCH_D / block_sizes[s];
+        double start = now();
+        struct hdc_sparse_model* model =
+            hdctrain_sparse(labels, samples, len, BENCH_CLASSES, blocks,
+                            block_sizes[s], BENCH_N, BENCH_MAXL, 1.0, 0.9);
+        double train_time = now() - start;
+        start = now();
+        struct hdc_accuracy accuracy =
+            hdcpredict_sparse(model, labels, samples, len, BENCH_N, 1.0);
+        double predict_time = now() - start;
+        printf("sparse: %dx%d %8.2f ms train, %8.2f ms predict, %6zu bytes "
+               "read per similarity, accuracy %.4f\n", blocks, block_sizes[s],
+               train_time * 1e3, predict_time * 1e3,
+               blocks * (sizeof(int) + sizeof(uint16_t)), accuracy.accuracy);
+        hdcdeinit_sparse(model);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int* labels = malloc(BENCH_SAMPLES * sizeof(int));
+    double** samples = malloc(BENCH_SAMPLES * sizeof(double*));
+    double* block = malloc(BENCH_SAMPLES * NUM_EMG_CHANNELS * sizeof(double));
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        samples[i] = block + i * NUM_EMG_CHANNELS;
+    }
+    hdc_gen_dataset(labels, samples, BENCH_SAMPLES, BENCH_CLASSES, BENCH_MAXL,
+                    12345, 1);
+
+    double start = now();
+    struct hdc_trained_model* model =
+        hdctrain(labels, samples, BENCH_SAMPLES, BENCH_CLASSES, BENCH_D,
+                 BENCH_N, BENCH_MAXL, 1.0, 0.9);
+    double train_time = now() - start;
+    start = now();
+    struct hdc_accuracy accuracy =
+        hdcpredict(model, labels, samples, BENCH_SAMPLES, BENCH_D, BENCH_N, 1.0);
+    double predict_time = now() - start;
+
+    printf("D=%d N=%d channels=%d classes=%d samples=%d\n", BENCH_D, BENCH_N,
+           NUM_EMG_CHANNELS, BENCH_CLASSES, BENCH_SAMPLES);
+    printf("hdctrain:   %8.2f ms\n", train_time * 1e3);
+    printf("hdcpredict: %8.2f ms (accuracy %.4f)\n", predict_time * 1e3,
+           accuracy.accuracy);
+
+    const struct hdc_kernels* generic =
+        &kernel_table[sizeof(kernel_table) / sizeof(kernel_table[0]) - 1];
+    const struct hdc_kernels* selected =
+        select_kernels(BENCH_D, BENCH_N, NUM_EMG_CHANNELS);
+    hdc_level_t* levels =
+        malloc(BENCH_SAMPLES * NUM_EMG_CHANNELS * sizeof(hdc_level_t));
+    bench_quantize(levels, samples, model->item_memories->cim_length);
+    double generic_ns = bench_kernels(generic, model, levels, BENCH_SAMPLES);
+    printf("generic kernels:     %10.0f ns/window\n", generic_ns);
+    if (selected != generic)
+    {
+        double fixed_ns = bench_kernels(selected, model, levels, BENCH_SAMPLES);
+        printf("specialized kernels: %10.0f ns/window (%.2fx)\n", fixed_ns,
+               generic_ns / fixed_ns);
+    }
+    else
+    {
+        printf("specialized kernels: not built for this configuration\n");
+    }
+
+    bench_compression(model, labels, samples, levels, BENCH_SAMPLES);
+    bench_index();
+    bench_sparse(labels, samples, BENCH_SAMPLES, train_time, predict_time);
+
+    free(levels);
+    hdcdeinit(model);
+    free(block);
+    free(samples);
+    free(labels);
+    return 0;
+}
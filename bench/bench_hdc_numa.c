@@ -0,0 +1,77 @@
+#include "../lib/hdc_numa.c" /* needed to benchmark remote routing */
+#include "../test/hdc_dataset.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_D 10000
+#define BENCH_N 4
+#define BENCH_MAXL 21
+#define BENCH_CLASSES 5
+#define BENCH_SAMPLES 8000
+#define BENCH_JOB_WINDOWS 64
+
+/**
+ * Returns the current monotonic time in seconds.
+ */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char* argv[])
+{
+    int* labels = malloc(BENCH_SAMPLES * sizeof(int));
+    double** samples = malloc(BENCH_SAMPLES * sizeof(double*));
+    double* block =
+        malloc(BENCH_SAMPLES * HDC_DATASET_CHANNELS * sizeof(double));
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        samples[i] = block + i * HDC_DATASET_CHANNELS;
+    }
+    hdc_gen_dataset(labels, samples, BENCH_SAMPLES, BENCH_CLASSES, BENCH_MAXL,
+                    12345, 1);
+
+    struct hdc_trained_model* model =
+        hdctrain(labels, samples, BENCH_SAMPLES, BENCH_CLASSES, BENCH_D,
+                 BENCH_N, BENCH_MAXL, 1.0, 0.9);
+    struct hdc_numa_pool* pool = hdc_numa_pool_create(model, BENCH_D);
+    hdcdeinit(model);
+
+    printf("NUMA nodes: %d, CPUs: %d\n", pool->num_nodes,
+           pool->cpu_offsets[pool->num_nodes]);
+    if (pool->num_nodes == 1)
+    {
+        printf("single node: remote routing uses the local replica\n");
+    }
+
+    int windows = BENCH_SAMPLES - BENCH_N + 1;
+    static const int workers_per_node[] = { 1, 0 };
+    for (int w = 0; w < 2; w++)
+    {
+        double throughput[2];
+        double accuracy = 0.0;
+        for (int remote = 0; remote <= 1; remote++)
+        {
+            double start = now();
+            struct hdc_accuracy result =
+                numa_predict(pool, labels, samples, BENCH_SAMPLES, BENCH_N,
+                             1.0, workers_per_node[w], BENCH_JOB_WINDOWS,
+                             remote);
+            throughput[remote] = windows / (now() - start);
+            accuracy = result.accuracy;
+        }
+        printf("workers/node=%s: local %10.0f windows/s, remote %10.0f "
+               "windows/s (%.2fx), accuracy %.4f\n",
+               workers_per_node[w] ? "1  " : "all", throughput[0],
+               throughput[1], throughput[0] / throughput[1], accuracy);
+    }
+
+    hdc_numa_pool_destroy(pool);
+    free(block);
+    free(samples);
+    free(labels);
+    return 0;
+}
@@ -7,6 +7,16 @@
 
 #define NUM_EMG_CHANNELS 4
 
+/* CiM level index of a quantized sample. Build with HDC_WIDE_LEVELS for CiMs
+ * of more than 256 levels. */
+#ifdef HDC_WIDE_LEVELS
+typedef uint16_t hdc_level_t;
+#define HDC_MAX_LEVELS 65536
+#else
+typedef uint8_t hdc_level_t;
+#define HDC_MAX_LEVELS 256
+#endif
+
 /**
  * Calculates the dot product of OP1 and OP2.
  * @param op1  First operand
@@ -90,7 +100,28 @@ static void circ_shift(double vec[], int len)
 }
 
 /**
- * Generates a random permutation of the integers from 1 to LEN inclusive.
+ * Counts the set bits of WORD.
+ * @param word  Input word
+ * @return Number of set bits in WORD
+ */
+static int popcount64(uint64_t word)
+{
+#if defined(__GNUC__) \
+    && (defined(__POPCNT__) || !(defined(__x86_64__) || defined(__i386__)))
+    return __builtin_popcountll(word);
+#else
+    /* Without a popcount instruction the builtin becomes a libgcc call, so
+     * count the bits of every byte in parallel instead */
+    word = word - ((word >> 1) & 0x5555555555555555ULL);
+    word = (word & 0x3333333333333333ULL)
+        + ((word >> 2) & 0x3333333333333333ULL);
+    word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (int)((word * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/**
+ * Generates a random permutation of the integers from 0 to LEN - 1 inclusive.
  * @param vec  Array to store random permutation in
  * @param len  Length of the random permutation
  */
@@ -99,13 +130,13 @@ static void rand_perm(int vec[], int len)
     /* Initialize vector */
     for (int i = 0; i < len; i++)
     {
-        vec[i] = i + 1;
+        vec[i] = i;
     }
 
     /* Randomly shuffle vector using Fisher-Yates */
     int j;
     int swap_temp;
-    for (int i = 0; i < len - 2; i++)
+    for (int i = 0; i < len - 1; i++)
     {
         j = i + (rand() % (len - i));
         swap_temp = vec[i];
@@ -137,7 +168,7 @@ static void gen_random_hv(double vec[], int len)
     {
         vec[randomIndices[i]] = 1;
     }
-    for (int i = len / 2 + 1; i < len; i++)
+    for (int i = len / 2; i < len; i++)
     {
         vec[randomIndices[i]] = -1;
     }
@@ -150,7 +181,7 @@ static void gen_random_hv(double vec[], int len)
  * @param maxl  Maximum amplitude of EMG signal
  * @return Initialized CiM and iM
  */
-static struct hdc_item_memories* init_item_memories(int len, double maxl)
+static struct hdc_item_memories* init_item_memories(int len, int maxl)
 {
     srand(1); /* Seed random number generator for predictable output */
 
@@ -158,7 +189,7 @@ static struct hdc_item_memories* init_item_memories(int len, double maxl)
     struct hdc_item_memories* memories =
         malloc(sizeof(struct hdc_item_memories));
     if (!memories) goto mem_error;
-    
+
     /* Initialize iM with 4 orthogonal hypervectors for the 4 channels */
     memories->im = malloc(NUM_EMG_CHANNELS * sizeof(double*));
     if (!memories->im) goto mem_error;
@@ -174,179 +205,431 @@ static struct hdc_item_memories* init_item_memories(int len, double maxl)
     memories->cim = malloc((maxl + 1) * sizeof(double*));
     if (!memories->cim) goto mem_error;
     memories->cim_length = maxl + 1;
-    double* init_hv = malloc(len * sizeof(double*));
-    if (!init_hv) goto mem_error;
-    double* current_hv = init_hv;
-    int* random_indices = malloc(len * sizeof(int*));
+    double* current_hv = malloc(len * sizeof(double));
+    if (!current_hv) goto mem_error;
+    gen_random_hv(current_hv, len);
+    int* random_indices = malloc(len * sizeof(int));
     if (!random_indices) goto mem_error;
     rand_perm(random_indices, len);
+    int sp = len / 2 / maxl;
     for (int i = 0; i <= maxl; i++)
     {
-        memories->cim[i] = malloc(len * sizeof(double*));
-        memcpy(memories->cim[i], current_hv, len);
-        int sp = (int)floor(len / 2 / maxl);
-        int start_index = (i * sp) + 1;
-        int end_index = ((i + 1) * sp) + 1;
-        for (int j = start_index; j <= end_index; j++)
+        memories->cim[i] = malloc(len * sizeof(double));
+        if (!memories->cim[i]) goto mem_error;
+        memcpy(memories->cim[i], current_hv, len * sizeof(double));
+        int start_index = i * sp;
+        int end_index = (i + 1) * sp;
+        for (int j = start_index; j <= end_index && j < len; j++)
         {
-            current_hv[j] *= -1;
+            current_hv[random_indices[j]] *= -1;
         }
     }
+    free(random_indices);
+    free(current_hv);
 
     return memories;
-    
+
 mem_error:
     fprintf(stderr, "init_item_memories: failed to allocate memory\n");
     return NULL;
 }
 
 /**
- * Recalls a vector from item memory based on inputs.
- * @param item_memory  item memory
- * @param im_length    length of item memory
- * @param raw_key      the input key
- * @param len          length of hypervectors
- * @param precision    precision used in quantization of input EMG signals
- * @return Pointer to copy of recalled vector (heap-allocated)
+ * Frees item memories allocated by init_item_memories.
+ * @param memories  Item memories to free
  */
-static double* lookup_item_memory(double** item_memory, int im_length, int raw_key,
-                               int len, double precision)
+static void deinit_item_memories(struct hdc_item_memories* memories)
 {
-    int key = (int)((double)raw_key * precision);
-    if (key < im_length)
+    for (int i = 0; i < memories->cim_length; i++)
     {
-        double* random_hv = malloc(im_length * sizeof(double));
-        if (!random_hv) goto mem_error;
-        memcpy(random_hv, item_memory[key], len);
-        return random_hv;
+        free(memories->cim[i]);
     }
-    else
+    free(memories->cim);
+    for (int i = 0; i < memories->im_length; i++)
     {
-        fprintf(stderr, "lookup_item_memory: cannot find key: %d\n", key);
-        return NULL;
+        free(memories->im[i]);
     }
-mem_error:
-    fprintf(stderr, "lookup_item_memory: failed to allocate memory\n");
-    return NULL;
+    free(memories->im);
+    free(memories);
 }
 
 /**
- * Computes Ngrams.
- * @param buffer         data buffer
- * @param item_memories  continuous and discrete item memories
- * @param len            length of hypervectors
- * @param n              length of data buffer
- * @param precision      precision used in quantization of input EMG signals
- * @return Pointer to ngram (heap-allocated)
+ * Quantizes COUNT contiguous input values into CiM level indices. Keys
+ * outside the CiM are clamped to its first or last level. The clamp and the
+ * range count are separate loops so that both vectorize; the block is still
+ * in cache for the second one.
+ * @param levels      Destination for COUNT level indices
+ * @param samples     COUNT input values
+ * @param count       Number of input values
+ * @param precision   precision used in quantization of input EMG signals
+ * @param cim_length  length of continuous item memory
+ * @return Number of keys that were clamped
  */
-static double* compute_ngram(double** buffer,
-                             struct hdc_item_memories* item_memories, int len,
-                             int n, double precision)
+static int quantize_samples(hdc_level_t* restrict levels,
+                            const double* restrict samples, size_t count,
+                            double precision, int cim_length)
 {
-    double* record = calloc(len, sizeof(double));
-    if (!record) goto mem_error;
-    double* ngram = calloc(len, sizeof(double));
-    if (!ngram) goto mem_error;
+    double max_key = cim_length - 1;
+    for (size_t i = 0; i < count; i++)
+    {
+        double key = samples[i] * precision;
+        key = key >= 0.0 ? key : 0.0;
+        key = key <= max_key ? key : max_key;
+        levels[i] = (hdc_level_t)(int32_t)key;
+    }
 
-    double* ch_1_hv = lookup_item_memory(item_memories->cim,
-                                         item_memories->cim_length,
-                                         buffer[1][1], len, precision);
-    double* ch_2_hv = lookup_item_memory(item_memories->cim,
-                                         item_memories->cim_length,
-                                         buffer[1][2], len, precision);
-    double* ch_3_hv = lookup_item_memory(item_memories->cim,
-                                         item_memories->cim_length,
-                                         buffer[1][3], len, precision);
-    double* ch_4_hv = lookup_item_memory(item_memories->cim,
-                                         item_memories->cim_length,
-                                         buffer[1][4], len, precision);
-    entrywise_product(ch_1_hv, ch_1_hv, item_memories->im[1], len);
-    entrywise_product(ch_2_hv, ch_2_hv, item_memories->im[2], len);
-    entrywise_product(ch_3_hv, ch_3_hv, item_memories->im[3], len);
-    entrywise_product(ch_4_hv, ch_4_hv, item_memories->im[4], len);
-    entrywise_sum(ngram, ngram, ch_1_hv, len);
-    entrywise_sum(ngram, ngram, ch_2_hv, len);
-    entrywise_sum(ngram, ngram, ch_3_hv, len);
-    entrywise_sum(ngram, ngram, ch_4_hv, len);
-    free(ch_1_hv);
-    free(ch_2_hv);
-    free(ch_3_hv);
-    free(ch_4_hv);
-
-    for (int i = 2; i <= n; i++)
-    {
-        ch_1_hv = lookup_item_memory(item_memories->cim,
-                                     item_memories->cim_length,
-                                     buffer[i][1], len, precision);
-        ch_2_hv = lookup_item_memory(item_memories->cim,
-                                     item_memories->cim_length,
-                                     buffer[i][2], len, precision);
-        ch_3_hv = lookup_item_memory(item_memories->cim,
-                                     item_memories->cim_length,
-                                     buffer[i][3], len, precision);
-        ch_4_hv = lookup_item_memory(item_memories->cim,
-                                     item_memories->cim_length,
-                                     buffer[i][4], len, precision);
-        entrywise_product(ch_1_hv, ch_1_hv, item_memories->im[1], len);
-        entrywise_product(ch_2_hv, ch_2_hv, item_memories->im[2], len);
-        entrywise_product(ch_3_hv, ch_3_hv, item_memories->im[3], len);
-        entrywise_product(ch_4_hv, ch_4_hv, item_memories->im[4], len);
-        entrywise_sum(record, record, ch_1_hv, len);
-        entrywise_sum(record, record, ch_2_hv, len);
-        entrywise_sum(record, record, ch_3_hv, len);
-        entrywise_sum(record, record, ch_4_hv, len);
-        free(ch_1_hv);
-        free(ch_2_hv);
-        free(ch_3_hv);
-        free(ch_4_hv);
-
-        circ_shift(ngram, len);
-        entrywise_product(ngram, ngram, record, len);
-    }
-
-    return ngram;
-    
-mem_error:
-    fprintf(stderr, "compute_ngram: failed to allocate memory\n");
-    return NULL;
+    /* Truncation maps keys above -1 to level 0 */
+    double in_range = 0.0;
+    for (size_t i = 0; i < count; i++)
+    {
+        double key = samples[i] * precision;
+        double inside = key > -1.0 ? 1.0 : 0.0;
+        in_range += key < cim_length ? inside : 0.0;
+    }
+    return (int)(count - (size_t)in_range);
+}
+
+/**
+ * Quantizes a block of samples into CiM level indices in one pass, so every
+ * sample is quantized once rather than once per ngram that includes it. When
+ * the rows are laid out back to back, as they are when the caller allocates
+ * the block in one piece, the whole block is quantized as a single
+ * contiguous array; otherwise each row is quantized on its own.
+ * @param levels      Destination for LEN rows of CHANNELS level indices
+ * @param samples     LEN rows of CHANNELS input samples
+ * @param len         Number of samples
+ * @param channels    Number of input channels
+ * @param precision   precision used in quantization of input EMG signals
+ * @param cim_length  length of continuous item memory
+ * @return Number of keys that were clamped
+ */
+static int quantize_block(hdc_level_t levels[], double** samples, int len,
+                          int channels, double precision, int cim_length)
+{
+    if (len <= 0) return 0;
+
+    /* Compare addresses as integers: pointer arithmetic past the end of
+     * SAMPLES[0] would be undefined when the rows are separate allocations */
+    uintptr_t row_bytes = (uintptr_t)channels * sizeof(double);
+    int contiguous = 1;
+    for (int i = 1; i < len && contiguous; i++)
+    {
+        contiguous = (uintptr_t)samples[i]
+            == (uintptr_t)samples[0] + (uintptr_t)i * row_bytes;
+    }
+    if (contiguous)
+    {
+        return quantize_samples(levels, samples[0], (size_t)len * channels,
+                                precision, cim_length);
+    }
+
+    int out_of_range = 0;
+    for (int i = 0; i < len; i++)
+    {
+        out_of_range += quantize_samples(levels + (size_t)i * channels,
+                                         samples[i], channels, precision,
+                                         cim_length);
+    }
+    return out_of_range;
 }
 
 /**
- * Computes hypervector sums.
- * @param buffer         data buffer
- * @param buffer_length  number of entries in data buffer
+ * Computes Ngrams. CiM and iM rows are bound straight into RECORD without
+ * copying the looked up vectors.
+ * @param ngram          destination for the ngram
+ * @param record         scratch vector of length LEN
+ * @param levels         N rows of quantized samples, one level per channel
  * @param item_memories  continuous and discrete item memories
  * @param len            length of hypervectors
  * @param n              size of Ngram
- * @param precision      precision used in quantization of input EMG signals
- * @return Pointer to hypervector sum (heap-allocated)
+ * @return 0, like the specialized kernels
+ */
+static int compute_ngram(double ngram[], double record[],
+                         const hdc_level_t levels[],
+                         struct hdc_item_memories* item_memories, int len,
+                         int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        memset(record, 0, len * sizeof(double));
+        const hdc_level_t* row = levels + (size_t)i * item_memories->im_length;
+        for (int ch = 0; ch < item_memories->im_length; ch++)
+        {
+            const double* cim = item_memories->cim[row[ch]];
+            const double* im = item_memories->im[ch];
+            for (int d = 0; d < len; d++)
+            {
+                record[d] += cim[d] * im[d];
+            }
+        }
+
+        if (i == 0)
+        {
+            memcpy(ngram, record, len * sizeof(double));
+        }
+        else
+        {
+            circ_shift(ngram, len);
+            entrywise_product(ngram, ngram, record, len);
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Kernels specialized for a fixed (D, N, channels) configuration. Every bound
+ * is a compile-time constant, so the compiler can fully unroll the channel
+ * loop, vectorize the D loop to exact widths and drop remainder handling. The
+ * n-gram kernel also binds CiM and iM rows in place instead of copying every
+ * looked up vector. The configurations are listed in hdc_kernels.def.
+ */
+#define HDC_DEFINE_FIXED_KERNELS(D_, N_, CH_)                                  \
+static int compute_ngram_##D_##_##N_##_##CH_(                                  \
+    double ngram[], double record[], const hdc_level_t levels[],               \
+    struct hdc_item_memories* item_memories, int len, int n)                   \
+{                                                                              \
+    double* cim[CH_];                                                          \
+    double** im = item_memories->im;                                           \
+    (void)record;                                                              \
+    (void)len;                                                                 \
+    (void)n;                                                                   \
+    for (int i = 0; i < N_; i++)                                               \
+    {                                                                          \
+        for (int ch = 0; ch < CH_; ch++)                                       \
+        {                                                                      \
+            cim[ch] = item_memories->cim[levels[i * CH_ + ch]];                \
+        }                                                                      \
+        if (i == 0)                                                            \
+        {                                                                      \
+            for (int d = 0; d < D_; d++)                                       \
+            {                                                                  \
+                double acc = 0.0;                                              \
+                for (int ch = 0; ch < CH_; ch++)                               \
+                {                                                              \
+                    acc += cim[ch][d] * im[ch][d];                             \
+                }                                                              \
+                ngram[d] = acc;                                                \
+            }                                                                  \
+        }                                                                      \
+        else                                                                   \
+        {                                                                      \
+            /* Shift and bind in one backwards pass */                         \
+            double last = ngram[D_ - 1];                                       \
+            for (int d = D_ - 1; d >= 0; d--)                                  \
+            {                                                                  \
+                double acc = 0.0;                                              \
+                for (int ch = 0; ch < CH_; ch++)                               \
+                {                                                              \
+                    acc += cim[ch][d] * im[ch][d];                             \
+                }                                                              \
+                ngram[d] = (d > 0 ? ngram[d - 1] : last) * acc;                \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+    return 0;                                                                  \
+}                                                                              \
+                                                                               \
+static double cos_angle_##D_##_##N_##_##CH_(double op1[], double op2[],        \
+                                            size_t len)                        \
+{                                                                              \
+    double dot = 0.0;                                                          \
+    double norm1 = 0.0;                                                        \
+    double norm2 = 0.0;                                                        \
+    (void)len;                                                                 \
+    for (int i = 0; i < D_; i++)                                               \
+    {                                                                          \
+        dot += op1[i] * op2[i];                                                \
+        norm1 += op1[i] * op1[i];                                              \
+        norm2 += op2[i] * op2[i];                                              \
+    }                                                                          \
+    return dot / (sqrt(norm1) * sqrt(norm2));                                  \
+}                                                                              \
+                                                                               \
+static void entrywise_sum_##D_##_##N_##_##CH_(double dest[], double op1[],     \
+                                              double op2[], size_t len)        \
+{                                                                              \
+    (void)len;                                                                 \
+    for (int i = 0; i < D_; i++)                                               \
+    {                                                                          \
+        dest[i] = op1[i] + op2[i];                                             \
+    }                                                                          \
+}
+
+#ifdef HDC_SPECIALIZED_KERNELS
+#define HDC_KERNEL_CONFIG(D, N, CH) HDC_DEFINE_FIXED_KERNELS(D, N, CH)
+#include "hdc_kernels.def"
+#undef HDC_KERNEL_CONFIG
+#endif
+
+/**
+ * Set of kernels used by training and prediction. D, N and channels are the
+ * configuration the kernels are specialized for, or 0 for the generic ones.
+ */
+struct hdc_kernels
+{
+    int D;
+    int N;
+    int channels;
+    int (*ngram)(double ngram[], double record[], const hdc_level_t levels[],
+                 struct hdc_item_memories* item_memories, int len, int n);
+    double (*similarity)(double op1[], double op2[], size_t len);
+    void (*bundle)(double dest[], double op1[], double op2[], size_t len);
+};
+
+static const struct hdc_kernels kernel_table[] =
+{
+#ifdef HDC_SPECIALIZED_KERNELS
+#define HDC_KERNEL_CONFIG(D, N, CH)                                            \
+    { D, N, CH, compute_ngram_##D##_##N##_##CH, cos_angle_##D##_##N##_##CH,    \
+      entrywise_sum_##D##_##N##_##CH },
+#include "hdc_kernels.def"
+#undef HDC_KERNEL_CONFIG
+#endif
+    { 0, 0, 0, compute_ngram, cos_angle, entrywise_sum } /* generic fallback */
+};
+
+/**
+ * Selects the kernels for a model configuration.
+ * @param D         Dimension of hypervectors
+ * @param N         Size of Ngram
+ * @param channels  Number of input channels
+ * @return Specialized kernels if the configuration was built in, else the
+ *         generic kernels
  */
-static double* compute_sum_hv(double** buffer, int buffer_length,
-                              struct hdc_item_memories* item_memories,
-                              int len, int n, double precision)
+static const struct hdc_kernels* select_kernels(int D, int N, int channels)
 {
-    double* sum_hv = calloc(len, sizeof(double));
-    if (!sum_hv) goto mem_error;
+    const struct hdc_kernels* kernels = kernel_table;
+    while (kernels->D != 0)
+    {
+        if (kernels->D == D && kernels->N == N && kernels->channels == channels)
+        {
+            break;
+        }
+        kernels++;
+    }
+    return kernels;
+}
 
-    for (int i = 1; i <= buffer_length - n + 1; i++)
+/**
+ * Finds the most frequent label of a window, preferring the lowest label on
+ * ties.
+ * @param labels       Labels of the window
+ * @param n            Length of the window
+ * @param frequencies  Scratch array of NUM_CLASSES entries
+ * @param num_classes  Number of classes
+ * @return Most frequent label
+ */
+static int window_label(int* labels, int n, int frequencies[], int num_classes)
+{
+    memset(frequencies, 0, num_classes * sizeof(int));
+    for (int j = 0; j < n; j++)
     {
-        double* new_ngram = compute_ngram(buffer + i, item_memories, len, n,
-                                          precision);
-        entrywise_sum(sum_hv, sum_hv, new_ngram, len);
-        free(new_ngram);
+        frequencies[labels[j]]++;
     }
+    int max_frequency = 0;
+    int label = 0;
+    for (int j = 0; j < num_classes; j++)
+    {
+        if (frequencies[j] > max_frequency)
+        {
+            max_frequency = frequencies[j];
+            label = j;
+        }
+    }
+    return label;
+}
 
-    return sum_hv;
-    
-mem_error:
-    fprintf(stderr, "compute_sum_hv: failed to allocate memory\n");
-    return NULL;
+/**
+ * Inserts a scored label into the descending top list of PREDICTION, keeping
+ * at most DEPTH entries. Equal similarities keep their insertion order.
+ * @param prediction  Prediction holding the top list
+ * @param depth       Maximum number of entries to keep
+ * @param label       Label to insert
+ * @param similarity  Similarity of LABEL
+ */
+static void insert_top_k(struct hdc_prediction* prediction, int depth,
+                         int label, double similarity)
+{
+    if (prediction->k == depth
+        && similarity <= prediction->similarities[depth - 1])
+    {
+        return;
+    }
+    int j = prediction->k < depth ? prediction->k++ : depth - 1;
+    while (j > 0 && prediction->similarities[j - 1] < similarity)
+    {
+        prediction->labels[j] = prediction->labels[j - 1];
+        prediction->similarities[j] = prediction->similarities[j - 1];
+        j--;
+    }
+    prediction->labels[j] = label;
+    prediction->similarities[j] = similarity;
+}
+
+/**
+ * Empties the top list of PREDICTION before a search for K labels.
+ * @param prediction  Prediction to fill
+ * @param k           Number of labels to report, at most HDC_MAX_TOP_K
+ * @return Depth to pass to insert_top_k. The second best class is always
+ *         tracked, so the margin is available even for K = 1
+ */
+static int begin_top_k(struct hdc_prediction* prediction, int k)
+{
+    prediction->k = 0;
+    return k < 2 ? 2 : k;
+}
+
+/**
+ * Completes a search started with begin_top_k: computes the margin and trims
+ * the top list to K labels. Every associative memory search ends here, so
+ * all model kinds report the same margin and sentinel.
+ * @param prediction  Prediction holding the top list
+ * @param k           Number of labels to report
+ * @return Best label, or -1 if no class has been trained
+ */
+static int finish_top_k(struct hdc_prediction* prediction, int k)
+{
+    double second = prediction->k > 1 ? prediction->similarities[1] : -1.0;
+    prediction->margin = prediction->k > 0
+        ? prediction->similarities[0] - second : 0.0;
+    prediction->rejected = 0;
+    if (prediction->k > k) prediction->k = k;
+    return prediction->k > 0 ? prediction->labels[0] : -1;
+}
+
+/**
+ * Finds the K classes most similar to HV in one pass over the associative
+ * memory. Classes that have not been trained are skipped.
+ * @param model       Trained HDC model
+ * @param hv          Query hypervector
+ * @param D           Dimension of hypervectors
+ * @param kernels     Kernels to compute similarities with
+ * @param k           Number of labels to report, at most HDC_MAX_TOP_K
+ * @param prediction  Receives the top K labels, similarities and margin
+ * @return Best label, or -1 if no class has been trained
+ */
+static int search_top_k(struct hdc_trained_model* model, double hv[], int D,
+                        const struct hdc_kernels* kernels, int k,
+                        struct hdc_prediction* prediction)
+{
+    int depth = begin_top_k(prediction, k);
+    for (int label = 0; label < model->num_classes; label++)
+    {
+        double angle = kernels->similarity(model->am[label], hv, D);
+        if (!isnan(angle))
+        {
+            insert_top_k(prediction, depth, label, angle);
+        }
+    }
+    return finish_top_k(prediction, k);
 }
 
 /**
  * Trains hyperdimensional computing model.
  * @param label_train_set  Training set labels
  * @param train_set        Training set data
+ * @param train_set_len    Length of training set
  * @param num_classes      Number of classes
  * @param D                Dimension of hypervectors
  * @param N                Size of Ngram
@@ -356,13 +639,22 @@ mem_error:
  * @return Trained hyperdimensional computing model
  */
 struct hdc_trained_model* hdctrain(int* label_train_set, double** train_set,
-                                   int num_classes, int D, int N, int maxl,
-                                   double precision, double cutting_angle)
+                                   int train_set_len, int num_classes, int D,
+                                   int N, int maxl, double precision,
+                                   double cutting_angle)
 {
+    if (maxl < 1 || maxl >= HDC_MAX_LEVELS)
+    {
+        fprintf(stderr, "hdctrain: maxl must be between 1 and %d\n",
+                HDC_MAX_LEVELS - 1);
+        return NULL;
+    }
+
     /* Initialize trained model */
     struct hdc_trained_model* model = malloc(sizeof(struct hdc_trained_model));
     if (!model) goto mem_error;
     model->item_memories = init_item_memories(D, maxl);
+    if (!model->item_memories) goto mem_error;
     model->num_pat = calloc(num_classes, sizeof(int));
     if (!model->num_pat) goto mem_error;
     model->am = malloc(num_classes * sizeof(double*));
@@ -371,23 +663,41 @@ struct hdc_trained_model* hdctrain(int* label_train_set, double** train_set,
     for (int i = 0; i < num_classes; i++)
     {
         model->am[i] = calloc(D, sizeof(double));
+        if (!model->am[i]) goto mem_error;
     }
 
+    const struct hdc_kernels* kernels =
+        select_kernels(D, N, model->item_memories->im_length);
+    double* ngram = malloc(D * sizeof(double));
+    if (!ngram) goto mem_error;
+    double* record = malloc(D * sizeof(double));
+    if (!record) goto mem_error;
+    int channels = model->item_memories->im_length;
+    hdc_level_t* levels =
+        malloc((size_t)train_set_len * channels * sizeof(hdc_level_t));
+    if (!levels) goto mem_error;
+    model->out_of_range =
+        quantize_block(levels, train_set, train_set_len, channels, precision,
+                       model->item_memories->cim_length);
+
     /* Train model */
-    int i = 1;
-    while (i < num_classes - N + 1)
+    int i = 0;
+    while (i < train_set_len - N + 1)
     {
-        if (label_train_set[i] == label_train_set[i + N - 1])
+        int label = label_train_set[i + N - 1];
+        if (label_train_set[i] == label)
         {
-            double* ngram = compute_ngram(train_set + i, model->item_memories,
-                                          D, N, precision);
-            double angle = cos_angle(ngram,
-                                     model->am[label_train_set[i + N - 1]], D);
-            if (angle < cutting_angle)
+            if (kernels->ngram(ngram, record, levels + (size_t)i * channels,
+                               model->item_memories, D, N) == 0)
             {
-                entrywise_sum(model->am[label_train_set[i + N - 1]],
-                              model->am[label_train_set[i + N - 1]], ngram, D);
-                model->num_pat[label_train_set[i + N - 1]]++;
+                double angle = kernels->similarity(ngram, model->am[label], D);
+                /* An empty class vector has an undefined angle */
+                if (angle < cutting_angle || isnan(angle))
+                {
+                    kernels->bundle(model->am[label], model->am[label], ngram,
+                                    D);
+                    model->num_pat[label]++;
+                }
             }
             i++;
         }
@@ -397,6 +707,10 @@ struct hdc_trained_model* hdctrain(int* label_train_set, double** train_set,
         }
     }
 
+    free(levels);
+    free(record);
+    free(ngram);
+
     return model;
 
 mem_error:
@@ -404,8 +718,107 @@ mem_error:
     return NULL;
 }
 
+/* Accuracy reported when a test run fails to allocate memory */
+static const struct hdc_accuracy failed_accuracy = { -1.0, -1.0 };
+
+/**
+ * Builds the accuracy of a test run from its counts. Callers that split a
+ * test set into jobs sum the counts of every job and build the total here.
+ * @param correct       Windows predicted correctly
+ * @param tranz_error   Wrong predictions on windows spanning a transition
+ * @param num_tests     Windows tested
+ * @param out_of_range  Test samples clamped to the CiM
+ * @return Accuracy of the test run
+ */
+struct hdc_accuracy hdcaccuracy(int correct, int tranz_error, int num_tests,
+                                int out_of_range)
+{
+    struct hdc_accuracy accuracies;
+    accuracies.accuracy = ((double)correct) / ((double)num_tests);
+    accuracies.acc_exc_trnz = ((double)(correct + tranz_error))
+        / ((double)num_tests);
+    accuracies.out_of_range = out_of_range;
+    accuracies.num_tests = num_tests;
+    accuracies.correct = correct;
+    accuracies.tranz_error = tranz_error;
+    return accuracies;
+}
+
+/**
+ * Tests a dense model. Implements hdcpredict, optionally reporting the label
+ * predicted for every window.
+ * @param predicted  If not NULL, receives the label predicted for each of the
+ *                   TEST_SET_LEN - N + 1 windows, or -1 where none was
+ * @return Accuracy of the model
+ */
+static struct hdc_accuracy predict_dense(struct hdc_trained_model* model,
+                                         int* label_test_set,
+                                         double** test_set, int test_set_len,
+                                         int D, int N, double precision,
+                                         int predicted[])
+{
+    int correct = 0;
+    int num_tests = 0;
+    int tranz_error = 0;
+
+    const struct hdc_kernels* kernels =
+        select_kernels(D, N, model->item_memories->im_length);
+    int* frequencies = malloc(model->num_classes * sizeof(int));
+    if (!frequencies) goto mem_error;
+    double* sig_hv = malloc(D * sizeof(double));
+    if (!sig_hv) goto mem_error;
+    double* record = malloc(D * sizeof(double));
+    if (!record) goto mem_error;
+    int channels = model->item_memories->im_length;
+    hdc_level_t* levels =
+        malloc((size_t)test_set_len * channels * sizeof(hdc_level_t));
+    if (!levels) goto mem_error;
+    int out_of_range =
+        quantize_block(levels, test_set, test_set_len, channels, precision,
+                       model->item_memories->cim_length);
+
+    for (int i = 0; i < test_set_len - N + 1; i++)
+    {
+        num_tests++;
+        if (predicted) predicted[i] = -1;
+        int actual_label = window_label(label_test_set + i, N, frequencies,
+                                        model->num_classes);
+
+        if (kernels->ngram(sig_hv, record, levels + (size_t)i * channels,
+                           model->item_memories, D, N) != 0)
+        {
+            continue;
+        }
+        struct hdc_prediction prediction;
+        int predict_label =
+            search_top_k(model, sig_hv, D, kernels, 1, &prediction);
+        if (predicted) predicted[i] = predict_label;
+
+        if (predict_label == actual_label)
+        {
+            correct++;
+        }
+        else if (label_test_set[i] != label_test_set[i + N - 1])
+        {
+            tranz_error++;
+        }
+    }
+
+    free(levels);
+    free(record);
+    free(sig_hv);
+    free(frequencies);
+
+    return hdcaccuracy(correct, tranz_error, num_tests, out_of_range);
+
+mem_error:
+    fprintf(stderr, "predict_dense: failed to allocate memory\n");
+    return failed_accuracy;
+}
+
 /**
- * Tests hyperdimensional computing model.
+ * Tests hyperdimensional computing model. Every window of N consecutive
+ * samples is classified by its own ngram; windows are not bundled.
  * @param model           Trained HDC model
  * @param label_test_set  Test set labels
  * @param test_set        Test set data
@@ -413,99 +826,1399 @@ mem_error:
  * @param D               Dimension of hypervectors
  * @param N               Size of Ngram
  * @param precision       Precision used in quantization of input EMG signals
- * @return Trained hyperdimensional computing model
+ * @return Accuracy of the model
  */
 struct hdc_accuracy hdcpredict(struct hdc_trained_model* model,
                                int* label_test_set, double** test_set,
                                int test_set_len, int D, int N, double precision)
 {
-    int correct = 0;
-    int num_tests = 0;
-    int tranz_error = 0;
+    return predict_dense(model, label_test_set, test_set, test_set_len, D, N,
+                         precision, NULL);
+}
 
-    for (int i = 0; i < test_set_len - N + 1; i++)
+/* Dimension and its variance across classes, for sorting during pruning */
+struct dim_variance
+{
+    int dim;
+    double variance;
+};
+
+/* Orders by descending variance, breaking ties by ascending dimension so the
+ * selection does not depend on the qsort implementation */
+static int compare_variance_desc(const void* a, const void* b)
+{
+    const struct dim_variance* da = a;
+    const struct dim_variance* db = b;
+    if (da->variance != db->variance)
     {
-        num_tests++;
-        int* frequencies = calloc(model->num_classes, sizeof(int));
-        if (!frequencies) goto mem_error;
-        for (int j = i; j < i + N - 1; j++)
+        return (da->variance < db->variance) - (da->variance > db->variance);
+    }
+    return (da->dim > db->dim) - (da->dim < db->dim);
+}
+
+static int compare_int(const void* a, const void* b)
+{
+    int ia = *(const int*)a;
+    int ib = *(const int*)b;
+    return (ia > ib) - (ia < ib);
+}
+
+/**
+ * Selects the NUM_DIMS dimensions of the normalized class vectors with the
+ * highest variance across classes, in ascending order.
+ * @param dims      Array to store NUM_DIMS selected dimensions in
+ * @param num_dims  Number of dimensions to keep
+ * @param model     Trained HDC model
+ * @param D         Dimension of hypervectors
+ * @return 0 on success, -1 on allocation failure
+ */
+static int select_dimensions(int dims[], int num_dims,
+                             struct hdc_trained_model* model, int D)
+{
+    if (num_dims == D)
+    {
+        for (int d = 0; d < D; d++)
         {
-            frequencies[label_test_set[j]]++;
+            dims[d] = d;
         }
-        int max_frequency = 0;
-        int actual_label = 0;
-        for (int j = 0; j < model->num_classes; j++)
+        return 0;
+    }
+
+    struct dim_variance* variances = calloc(D, sizeof(struct dim_variance));
+    if (!variances) return -1;
+    double* scale = malloc(model->num_classes * sizeof(double));
+    if (!scale)
+    {
+        free(variances);
+        return -1;
+    }
+    for (int c = 0; c < model->num_classes; c++)
+    {
+        double class_norm = norm(model->am[c], D);
+        scale[c] = class_norm > 0.0 ? 1.0 / class_norm : 0.0;
+    }
+    for (int d = 0; d < D; d++)
+    {
+        double sum = 0.0;
+        double sum_sq = 0.0;
+        for (int c = 0; c < model->num_classes; c++)
         {
-            if (frequencies[label_test_set[j]] > max_frequency)
-            {
-                max_frequency = frequencies[label_test_set[j]];
-                actual_label = label_test_set[j];
-            }
+            double value = model->am[c][d] * scale[c];
+            sum += value;
+            sum_sq += value * value;
         }
-        free(frequencies);
+        double mean = sum / model->num_classes;
+        variances[d].dim = d;
+        variances[d].variance = sum_sq / model->num_classes - mean * mean;
+    }
 
-        double* sig_hv = compute_sum_hv(test_set + i, i, model->item_memories,
-                                        D, N, precision);
-        double max_angle = -1;
-        int predict_label = -1;
+    qsort(variances, D, sizeof(struct dim_variance), compare_variance_desc);
+    for (int j = 0; j < num_dims; j++)
+    {
+        dims[j] = variances[j].dim;
+    }
+    qsort(dims, num_dims, sizeof(int), compare_int);
 
-        for (int label = 1; label <= model->num_classes; label++)
-        {
-            double angle = cos_angle(model->am[label], sig_hv, D);
-            if (angle > max_angle)
-            {
-                max_angle = angle;
-                predict_label = label;
-            }
-        }
-        
-        free(sig_hv);
+    free(scale);
+    free(variances);
+    return 0;
+}
 
-        if (predict_label == actual_label)
+/**
+ * Packs the signs of the kept dimensions of HV into a bit vector, with a set
+ * bit for a negative entry.
+ * @param dest   Destination bit vector of MODEL->words words
+ * @param hv     Hypervector of length MODEL->D
+ * @param model  Compressed HDC model
+ */
+static void pack_signs(uint64_t dest[], double hv[],
+                       struct hdc_compressed_model* model)
+{
+    memset(dest, 0, model->words * sizeof(uint64_t));
+    for (int j = 0; j < model->num_dims; j++)
+    {
+        if (hv[model->dims[j]] < 0)
         {
-            correct++;
+            dest[j / 64] |= (uint64_t)1 << (j % 64);
         }
-        else if (label_test_set[i] != label_test_set[i + N - 1])
+    }
+}
+
+/**
+ * Scores one class of the compressed associative memory against a
+ * sign-packed query. The score is the dot product of the quantized class
+ * vector with the bipolar query, computed from popcounts of each bit-plane
+ * against the sign disagreement mask.
+ * @param model  Compressed HDC model
+ * @param label  Class to score
+ * @param query  Sign-packed query of MODEL->words words
+ * @return Cosine similarity of the class and the query, or NaN if the class
+ *         has not been trained
+ */
+static double score_compressed(struct hdc_compressed_model* model, int label,
+                               uint64_t query[])
+{
+    if (model->norms[label] == 0.0) return NAN;
+    int words = model->words;
+    uint64_t* planes = model->planes + (size_t)label * model->bits * words;
+    long score = 0;
+    for (int w = 0; w < words; w++)
+    {
+        uint64_t disagree = planes[w] ^ query[w];
+        score -= 2 * popcount64(disagree);
+        for (int k = 1; k < model->bits; k++)
         {
-            tranz_error++;
+            uint64_t magnitude = planes[k * words + w];
+            score += (2L << (k - 1))
+                * (popcount64(magnitude)
+                   - 2 * popcount64(magnitude & disagree));
         }
     }
+    score += model->num_dims;
 
-    struct hdc_accuracy accuracies;
-    accuracies.accuracy = ((double)correct) / ((double)num_tests);
-    accuracies.acc_exc_trnz = ((double)(correct + tranz_error))
-        / ((double)num_tests);
+    return score / (model->norms[label] * sqrt((double)model->num_dims));
+}
 
-    return accuracies;
-    
-mem_error:
-    fprintf(stderr, "hdcpredict: failed to allocate memory\n");
-    struct hdc_accuracy failed_accuracy;
-    return failed_accuracy;
+/**
+ * Finds the K classes of the compressed associative memory closest to a
+ * sign-packed query.
+ * @param model       Compressed HDC model
+ * @param query       Sign-packed query of MODEL->words words
+ * @param k           Number of labels to report, at most HDC_MAX_TOP_K
+ * @param prediction  Receives the top K labels, similarities and margin
+ * @return Best matching label, or -1 if no class has been trained
+ */
+static int search_compressed(struct hdc_compressed_model* model,
+                             uint64_t query[], int k,
+                             struct hdc_prediction* prediction)
+{
+    int depth = begin_top_k(prediction, k);
+    for (int label = 0; label < model->num_classes; label++)
+    {
+        double angle = score_compressed(model, label, query);
+        if (!isnan(angle))
+        {
+            insert_top_k(prediction, depth, label, angle);
+        }
+    }
+    return finish_top_k(prediction, k);
 }
 
 /**
- * Frees memory allocated for HDC model
- * @param model  Model allocated by hdctrain
+ * Compresses the associative memory of a trained model. Every class vector is
+ * reduced to a sign bit-plane plus BITS - 1 magnitude bit-planes, which encode
+ * the odd weights 1, 3, ..., 2^BITS - 1 relative to its largest entry. Only
+ * the KEEP_FRACTION of dimensions with the highest variance across the
+ * normalized class vectors are kept.
+ * @param model          Trained HDC model
+ * @param D              Dimension of hypervectors
+ * @param bits           Bit-planes per class vector (1 binarizes)
+ * @param keep_fraction  Fraction of dimensions to keep, in (0, 1]
+ * @return Compressed HDC model sharing the item memories of MODEL
  */
-void hdcdeinit(struct hdc_trained_model* model)
+struct hdc_compressed_model* hdccompress(struct hdc_trained_model* model, int D,
+                                         int bits, double keep_fraction)
 {
-    free(model->num_pat);
-    for (int i = 0; i < model->num_classes; i++)
+    if (bits < 1 || bits > 16 || keep_fraction <= 0.0 || keep_fraction > 1.0)
     {
-        free(model->am[i]);
+        fprintf(stderr, "hdccompress: invalid bits or keep fraction\n");
+        return NULL;
     }
-    free(model->am);
-    for (int i = 0; i < model->item_memories->cim_length; i++)
+
+    struct hdc_compressed_model* compressed =
+        malloc(sizeof(struct hdc_compressed_model));
+    if (!compressed) goto mem_error;
+    compressed->item_memories = model->item_memories;
+    compressed->num_classes = model->num_classes;
+    compressed->D = D;
+    compressed->num_dims = (int)(keep_fraction * D);
+    if (compressed->num_dims < 1) compressed->num_dims = 1;
+    compressed->bits = bits;
+    compressed->words = (compressed->num_dims + 63) / 64;
+    compressed->dims = malloc(compressed->num_dims * sizeof(int));
+    if (!compressed->dims) goto mem_error;
+    compressed->planes = calloc((size_t)model->num_classes * bits
+                                * compressed->words, sizeof(uint64_t));
+    if (!compressed->planes) goto mem_error;
+    compressed->norms = malloc(model->num_classes * sizeof(double));
+    if (!compressed->norms) goto mem_error;
+    if (select_dimensions(compressed->dims, compressed->num_dims, model, D))
     {
-        free(model->item_memories->cim[i]);
+        goto mem_error;
     }
-    free(model->item_memories->cim);
-    for (int i = 0; i < model->item_memories->im_length; i++)
+
+    int words = compressed->words;
+    int max_level = (1 << (bits - 1)) - 1;
+    for (int label = 0; label < model->num_classes; label++)
     {
-        free(model->item_memories->im[i]);
+        double* am = model->am[label];
+        uint64_t* planes = compressed->planes + (size_t)label * bits * words;
+        double max_abs = 0.0;
+        for (int j = 0; j < compressed->num_dims; j++)
+        {
+            double value = fabs(am[compressed->dims[j]]);
+            if (value > max_abs) max_abs = value;
+        }
+
+        pack_signs(planes, am, compressed);
+        double norm_sq = 0.0;
+        for (int j = 0; j < compressed->num_dims; j++)
+        {
+            double value = fabs(am[compressed->dims[j]]);
+            int level = max_abs > 0.0
+                ? (int)(value / max_abs * (max_level + 1)) : 0;
+            if (level > max_level) level = max_level;
+            for (int k = 1; k < bits; k++)
+            {
+                if (level & (1 << (k - 1)))
+                {
+                    planes[k * words + j / 64] |= (uint64_t)1 << (j % 64);
+                }
+            }
+            double weight = 2 * level + 1;
+            norm_sq += weight * weight;
+        }
+        compressed->norms[label] = max_abs > 0.0 ? sqrt(norm_sq) : 0.0;
     }
-    free(model->item_memories->im);
-    free(model->item_memories);
-    free(model);
+
+    compressed->bytes = sizeof(struct hdc_compressed_model)
+        + compressed->num_dims * sizeof(int)
+        + (size_t)model->num_classes * bits * words * sizeof(uint64_t)
+        + model->num_classes * sizeof(double);
+
+    return compressed;
+
+mem_error:
+    fprintf(stderr, "hdccompress: failed to allocate memory\n");
+    return NULL;
+}
+
+/**
+ * Assigns every class of the index model to its nearest list centroid by
+ * Hamming distance of the sign bit-planes.
+ * @param index       Index being built
+ * @param assignment  Array to store the list of each class in
+ */
+static void assign_lists(struct hdc_am_index* index, int assignment[])
+{
+    struct hdc_compressed_model* model = index->model;
+    int words = model->words;
+    for (int label = 0; label < model->num_classes; label++)
+    {
+        uint64_t* signs = model->planes + (size_t)label * model->bits * words;
+        int min_distance = model->num_dims + 1;
+        for (int list = 0; list < index->num_lists; list++)
+        {
+            uint64_t* centroid = index->centroids + (size_t)list * words;
+            int distance = 0;
+            for (int w = 0; w < words; w++)
+            {
+                distance += popcount64(signs[w] ^ centroid[w]);
+            }
+            if (distance < min_distance)
+            {
+                min_distance = distance;
+                assignment[label] = list;
+            }
+        }
+    }
+}
+
+/**
+ * Builds a two-level index over a compressed associative memory. The classes
+ * are clustered into NUM_LISTS lists by k-means on their sign bit-planes,
+ * with each centroid being the bitwise majority of its members. A search
+ * compares the query with the centroids first and then scores only the
+ * classes of the closest lists, so with about sqrt(classes) lists its cost
+ * grows with the square root of the number of classes.
+ * @param model       Compressed HDC model, which must outlive the index
+ * @param num_lists   Number of lists
+ * @param iterations  Number of k-means iterations
+ * @return Index over MODEL
+ */
+struct hdc_am_index* hdcindex(struct hdc_compressed_model* model, int num_lists,
+                              int iterations)
+{
+    if (num_lists < 1)
+    {
+        fprintf(stderr, "hdcindex: invalid number of lists\n");
+        return NULL;
+    }
+    if (num_lists > model->num_classes) num_lists = model->num_classes;
+
+    int words = model->words;
+    int num_classes = model->num_classes;
+    struct hdc_am_index* index = malloc(sizeof(struct hdc_am_index));
+    if (!index) goto mem_error;
+    index->model = model;
+    index->num_lists = num_lists;
+    index->centroids = malloc((size_t)num_lists * words * sizeof(uint64_t));
+    if (!index->centroids) goto mem_error;
+    index->list_offsets = calloc(num_lists + 1, sizeof(int));
+    if (!index->list_offsets) goto mem_error;
+    index->list_labels = malloc(num_classes * sizeof(int));
+    if (!index->list_labels) goto mem_error;
+    int* assignment = malloc(num_classes * sizeof(int));
+    if (!assignment) goto mem_error;
+    int* counts = malloc((size_t)num_lists * model->num_dims * sizeof(int));
+    if (!counts) goto mem_error;
+
+    /* Seed the centroids with evenly spaced classes */
+    for (int list = 0; list < num_lists; list++)
+    {
+        int label = (int)((long)list * num_classes / num_lists);
+        memcpy(index->centroids + (size_t)list * words,
+               model->planes + (size_t)label * model->bits * words,
+               words * sizeof(uint64_t));
+    }
+    assign_lists(index, assignment);
+
+    for (int it = 0; it < iterations; it++)
+    {
+        memset(index->list_offsets, 0, (num_lists + 1) * sizeof(int));
+        memset(counts, 0, (size_t)num_lists * model->num_dims * sizeof(int));
+        for (int label = 0; label < num_classes; label++)
+        {
+            uint64_t* signs =
+                model->planes + (size_t)label * model->bits * words;
+            int* list_counts = counts + (size_t)assignment[label]
+                * model->num_dims;
+            for (int j = 0; j < model->num_dims; j++)
+            {
+                list_counts[j] += (signs[j / 64] >> (j % 64)) & 1;
+            }
+            index->list_offsets[assignment[label]]++;
+        }
+        for (int list = 0; list < num_lists; list++)
+        {
+            int size = index->list_offsets[list];
+            if (size == 0) continue; /* keep the centroid of an empty list */
+            uint64_t* centroid = index->centroids + (size_t)list * words;
+            int* list_counts = counts + (size_t)list * model->num_dims;
+            memset(centroid, 0, words * sizeof(uint64_t));
+            for (int j = 0; j < model->num_dims; j++)
+            {
+                if (2 * list_counts[j] > size)
+                {
+                    centroid[j / 64] |= (uint64_t)1 << (j % 64);
+                }
+            }
+        }
+        assign_lists(index, assignment);
+    }
+
+    /* Group the class labels by list */
+    memset(index->list_offsets, 0, (num_lists + 1) * sizeof(int));
+    for (int label = 0; label < num_classes; label++)
+    {
+        index->list_offsets[assignment[label] + 1]++;
+    }
+    for (int list = 0; list < num_lists; list++)
+    {
+        index->list_offsets[list + 1] += index->list_offsets[list];
+    }
+    memcpy(counts, index->list_offsets, num_lists * sizeof(int));
+    for (int label = 0; label < num_classes; label++)
+    {
+        index->list_labels[counts[assignment[label]]++] = label;
+    }
+
+    free(counts);
+    free(assignment);
+    return index;
+
+mem_error:
+    fprintf(stderr, "hdcindex: failed to allocate memory\n");
+    return NULL;
+}
+
+/**
+ * Searches a compressed associative memory through its index.
+ * @param index       Index built by hdcindex
+ * @param query       Sign-packed query of MODEL->words words
+ * @param nprobe      Number of closest lists to search
+ * @param probes      Scratch array of INDEX->num_lists entries
+ * @param distances   Scratch array of INDEX->num_lists entries
+ * @param k           Number of labels to report, at most HDC_MAX_TOP_K
+ * @param prediction  Receives the top K probed labels, similarities and
+ *                    margin
+ * @return Best matching label, or -1 if no probed class has been trained
+ */
+static int search_index(struct hdc_am_index* index, uint64_t query[],
+                        int nprobe, int probes[], int distances[], int k,
+                        struct hdc_prediction* prediction)
+{
+    int words = index->model->words;
+    int num_probes = 0;
+    if (nprobe < 1) nprobe = 1;
+    if (nprobe > index->num_lists) nprobe = index->num_lists;
+
+    /* Coarse search: the NPROBE centroids closest to the query */
+    for (int list = 0; list < index->num_lists; list++)
+    {
+        uint64_t* centroid = index->centroids + (size_t)list * words;
+        int distance = 0;
+        for (int w = 0; w < words; w++)
+        {
+            distance += popcount64(centroid[w] ^ query[w]);
+        }
+        if (num_probes == nprobe && distance >= distances[nprobe - 1])
+        {
+            continue;
+        }
+        int j = num_probes < nprobe ? num_probes++ : nprobe - 1;
+        while (j > 0 && distances[j - 1] > distance)
+        {
+            probes[j] = probes[j - 1];
+            distances[j] = distances[j - 1];
+            j--;
+        }
+        probes[j] = list;
+        distances[j] = distance;
+    }
+
+    /* Fine search: score the classes of the probed lists */
+    int depth = begin_top_k(prediction, k);
+    for (int p = 0; p < num_probes; p++)
+    {
+        int list = probes[p];
+        for (int i = index->list_offsets[list];
+             i < index->list_offsets[list + 1]; i++)
+        {
+            int label = index->list_labels[i];
+            double angle = score_compressed(index->model, label, query);
+            if (!isnan(angle))
+            {
+                insert_top_k(prediction, depth, label, angle);
+            }
+        }
+    }
+    return finish_top_k(prediction, k);
+}
+
+/**
+ * Tests a compressed model, either by scanning its whole bit-packed
+ * associative memory or, when INDEX is given, by searching only the classes
+ * of the NPROBE index lists closest to each query. Shared by
+ * hdcpredict_compressed and hdcpredict_indexed.
+ * @param model           Compressed HDC model
+ * @param index           Index to search MODEL through, or NULL to scan it
+ * @param nprobe          Number of index lists to search; ignored without
+ *                        INDEX
+ * @param label_test_set  Test set labels
+ * @param test_set        Test set data
+ * @param test_set_len    Length of test set
+ * @param N               Size of Ngram
+ * @param precision       Precision used in quantization of input EMG signals
+ * @param predicted       If not NULL, receives the label predicted for each
+ *                        window, or -1 where none was
+ * @return Accuracy of the compressed or indexed model
+ */
+static struct hdc_accuracy predict_packed(struct hdc_compressed_model* model,
+                                          struct hdc_am_index* index,
+                                          int nprobe, int* label_test_set,
+                                          double** test_set, int test_set_len,
+                                          int N, double precision,
+                                          int predicted[])
+{
+    int correct = 0;
+    int num_tests = 0;
+    int tranz_error = 0;
+    int D = model->D;
+
+    const struct hdc_kernels* kernels =
+        select_kernels(D, N, model->item_memories->im_length);
+    int* frequencies = malloc(model->num_classes * sizeof(int));
+    if (!frequencies) goto mem_error;
+    double* sig_hv = malloc(D * sizeof(double));
+    if (!sig_hv) goto mem_error;
+    double* record = malloc(D * sizeof(double));
+    if (!record) goto mem_error;
+    int channels = model->item_memories->im_length;
+    hdc_level_t* levels =
+        malloc((size_t)test_set_len * channels * sizeof(hdc_level_t));
+    if (!levels) goto mem_error;
+    int out_of_range =
+        quantize_block(levels, test_set, test_set_len, channels, precision,
+                       model->item_memories->cim_length);
+    uint64_t* query = malloc(model->words * sizeof(uint64_t));
+    if (!query) goto mem_error;
+    int* probes = NULL;
+    int* distances = NULL;
+    if (index)
+    {
+        probes = malloc(index->num_lists * sizeof(int));
+        if (!probes) goto mem_error;
+        distances = malloc(index->num_lists * sizeof(int));
+        if (!distances) goto mem_error;
+    }
+
+    for (int i = 0; i < test_set_len - N + 1; i++)
+    {
+        num_tests++;
+        if (predicted) predicted[i] = -1;
+        int actual_label = window_label(label_test_set + i, N, frequencies,
+                                        model->num_classes);
+
+        if (kernels->ngram(sig_hv, record, levels + (size_t)i * channels,
+                           model->item_memories, D, N) != 0)
+        {
+            continue;
+        }
+        pack_signs(query, sig_hv, model);
+        struct hdc_prediction prediction;
+        int predict_label = index
+            ? search_index(index, query, nprobe, probes, distances, 1,
+                           &prediction)
+            : search_compressed(model, query, 1, &prediction);
+        if (predicted) predicted[i] = predict_label;
+
+        if (predict_label == actual_label)
+        {
+            correct++;
+        }
+        else if (label_test_set[i] != label_test_set[i + N - 1])
+        {
+            tranz_error++;
+        }
+    }
+
+    free(distances);
+    free(probes);
+    free(query);
+    free(levels);
+    free(record);
+    free(sig_hv);
+    free(frequencies);
+
+    return hdcaccuracy(correct, tranz_error, num_tests, out_of_range);
+
+mem_error:
+    fprintf(stderr, "predict_packed: failed to allocate memory\n");
+    return failed_accuracy;
+}
+
+/**
+ * Tests a compressed hyperdimensional computing model. Matches hdcpredict,
+ * but searches the bit-packed associative memory with the sign of each ngram.
+ * @param model           Compressed HDC model
+ * @param label_test_set  Test set labels
+ * @param test_set        Test set data
+ * @param test_set_len    Length of test set
+ * @param N               Size of Ngram
+ * @param precision       Precision used in quantization of input EMG signals
+ * @return Accuracy of the compressed model
+ */
+struct hdc_accuracy hdcpredict_compressed(struct hdc_compressed_model* model,
+                                          int* label_test_set,
+                                          double** test_set, int test_set_len,
+                                          int N, double precision)
+{
+    return predict_packed(model, NULL, 0, label_test_set, test_set,
+                          test_set_len, N, precision, NULL);
+}
+
+/**
+ * Tests a compressed hyperdimensional computing model through its index.
+ * @param index           Index built by hdcindex
+ * @param nprobe          Number of closest lists to search; higher values
+ *                        trade speed for recall
+ * @param label_test_set  Test set labels
+ * @param test_set        Test set data
+ * @param test_set_len    Length of test set
+ * @param N               Size of Ngram
+ * @param precision       Precision used in quantization of input EMG signals
+ * @return Accuracy of the indexed model
+ */
+struct hdc_accuracy hdcpredict_indexed(struct hdc_am_index* index, int nprobe,
+                                       int* label_test_set, double** test_set,
+                                       int test_set_len, int N,
+                                       double precision)
+{
+    return predict_packed(index->model, index, nprobe, label_test_set,
+                          test_set, test_set_len, N, precision, NULL);
+}
+
+/**
+ * Frees memory allocated for a compressed HDC model. The item memories belong
+ * to the trained model and are not freed.
+ * @param model  Model allocated by hdccompress
+ */
+void hdcdeinit_compressed(struct hdc_compressed_model* model)
+{
+    free(model->norms);
+    free(model->planes);
+    free(model->dims);
+    free(model);
+}
+
+/**
+ * Frees memory allocated for an index. The indexed model is not freed.
+ * @param index  Index allocated by hdcindex
+ */
+void hdcdeinit_index(struct hdc_am_index* index)
+{
+    free(index->list_labels);
+    free(index->list_offsets);
+    free(index->centroids);
+    free(index);
+}
+
+/**
+ * Generates a random block-sparse hypervector, with one active position per
+ * block.
+ * @param vec         Array of BLOCKS active positions
+ * @param blocks      Number of blocks
+ * @param block_size  Number of positions per block
+ */
+static void gen_random_sparse_hv(uint16_t vec[], int blocks, int block_size)
+{
+    for (int b = 0; b < blocks; b++)
+    {
+        vec[b] = (uint16_t)(rand() % block_size);
+    }
+}
+
+/**
+ * Binds two block-sparse hypervectors by adding their active positions
+ * block-wise modulo the block size.
+ * @param dest        Destination vector
+ * @param op1         First operand
+ * @param op2         Second operand
+ * @param blocks      Number of blocks
+ * @param block_size  Number of positions per block
+ */
+static void sparse_bind(uint16_t dest[], const uint16_t op1[],
+                        const uint16_t op2[], int blocks, int block_size)
+{
+    for (int b = 0; b < blocks; b++)
+    {
+        int sum = op1[b] + op2[b];
+        dest[b] = (uint16_t)(sum >= block_size ? sum - block_size : sum);
+    }
+}
+
+/**
+ * Bundles a block-sparse hypervector into a class vector, which holds a count
+ * per position. Only the active positions of HV are touched.
+ * @param counts      Class vector of BLOCKS x BLOCK_SIZE counts
+ * @param norm_sq     Squared norm of COUNTS, updated in place
+ * @param hv          Block-sparse hypervector
+ * @param blocks      Number of blocks
+ * @param block_size  Number of positions per block
+ */
+static void sparse_bundle(int counts[], double* norm_sq, const uint16_t hv[],
+                          int blocks, int block_size)
+{
+    for (int b = 0; b < blocks; b++)
+    {
+        int* count = counts + (size_t)b * block_size + hv[b];
+        *norm_sq += 2 * *count + 1;
+        (*count)++;
+    }
+}
+
+/**
+ * Calculates the cosine similarity of a class vector and a block-sparse
+ * hypervector, reading only the class counts at the active positions of HV.
+ * @param counts      Class vector of BLOCKS x BLOCK_SIZE counts
+ * @param norm_sq     Squared norm of COUNTS
+ * @param hv          Block-sparse hypervector
+ * @param blocks      Number of blocks
+ * @param block_size  Number of positions per block
+ * @return Cosine similarity, or NaN if the class vector is empty
+ */
+static double sparse_similarity(const int counts[], double norm_sq,
+                                const uint16_t hv[], int blocks,
+                                int block_size)
+{
+    long dot = 0;
+    for (int b = 0; b < blocks; b++)
+    {
+        dot += counts[(size_t)b * block_size + hv[b]];
+    }
+    return dot / (sqrt(norm_sq) * sqrt((double)blocks));
+}
+
+/**
+ * Encodes one quantized sample as a block-sparse hypervector. Every channel
+ * binds its CiM level to its iM vector, and the channels are bundled by
+ * keeping, per block, the position most channels agree on. Ties rotate the
+ * preferred channel from block to block, so each channel keeps an equal
+ * share of the blocks.
+ * @param record  Destination vector
+ * @param levels  One level per channel
+ * @param model   Sparse HDC model
+ */
+static void sparse_record(uint16_t record[], const hdc_level_t levels[],
+                          struct hdc_sparse_model* model)
+{
+    int channels = model->im_length;
+    int blocks = model->blocks;
+    const uint16_t* cim[HDC_SPARSE_MAX_CHANNELS];
+    for (int ch = 0; ch < channels; ch++)
+    {
+        cim[ch] = model->cim + (size_t)levels[ch] * blocks;
+    }
+
+    for (int b = 0; b < blocks; b++)
+    {
+        int bound[HDC_SPARSE_MAX_CHANNELS];
+        for (int ch = 0; ch < channels; ch++)
+        {
+            int sum = cim[ch][b] + model->im[(size_t)ch * blocks + b];
+            bound[ch] = sum >= model->block_size ? sum - model->block_size
+                                                 : sum;
+        }
+        int best = 0;
+        int best_votes = 0;
+        for (int i = 0; i < channels; i++)
+        {
+            int candidate = bound[(b + i) % channels];
+            int votes = 0;
+            for (int ch = 0; ch < channels; ch++)
+            {
+                votes += bound[ch] == candidate;
+            }
+            if (votes > best_votes)
+            {
+                best_votes = votes;
+                best = candidate;
+            }
+        }
+        record[b] = (uint16_t)best;
+    }
+}
+
+/**
+ * Computes a block-sparse Ngram. Blocks are rotated by one block as the
+ * permutation, which keeps the vector block-sparse.
+ * @param ngram   Destination vector
+ * @param record  Scratch vector
+ * @param levels  N rows of quantized samples, one level per channel
+ * @param model   Sparse HDC model
+ * @param n       Size of Ngram
+ */
+static void compute_sparse_ngram(uint16_t ngram[], uint16_t record[],
+                                 const hdc_level_t levels[],
+                                 struct hdc_sparse_model* model, int n)
+{
+    int blocks = model->blocks;
+    sparse_record(ngram, levels, model);
+    for (int i = 1; i < n; i++)
+    {
+        sparse_record(record, levels + (size_t)i * model->im_length, model);
+        uint16_t last = ngram[blocks - 1];
+        memmove(ngram + 1, ngram, (blocks - 1) * sizeof(uint16_t));
+        ngram[0] = last;
+        sparse_bind(ngram, ngram, record, blocks, model->block_size);
+    }
+}
+
+/**
+ * Finds the K classes of a sparse model most similar to HV. Classes that have
+ * not been trained are skipped.
+ * @param model       Trained sparse HDC model
+ * @param hv          Block-sparse query hypervector
+ * @param k           Number of labels to report, at most HDC_MAX_TOP_K
+ * @param prediction  Receives the top K labels, similarities and margin
+ * @return Best label, or -1 if no class has been trained
+ */
+static int search_sparse(struct hdc_sparse_model* model, const uint16_t hv[],
+                         int k, struct hdc_prediction* prediction)
+{
+    size_t class_size = (size_t)model->blocks * model->block_size;
+    int depth = begin_top_k(prediction, k);
+    for (int label = 0; label < model->num_classes; label++)
+    {
+        double angle = sparse_similarity(model->am + label * class_size,
+                                         model->am_norms_sq[label], hv,
+                                         model->blocks, model->block_size);
+        if (!isnan(angle))
+        {
+            insert_top_k(prediction, depth, label, angle);
+        }
+    }
+    return finish_top_k(prediction, k);
+}
+
+/**
+ * Initialize block-sparse item memories of a sparse model. Consecutive CiM
+ * levels differ in about BLOCKS / MAXL re-drawn blocks, and every block is
+ * re-drawn at exactly one level. Where the dense CiM needs D / 2 flips for
+ * its extremes to be orthogonal, the lowest and highest sparse levels only
+ * become dissimilar once every block has been re-drawn; they then share no
+ * active position.
+ * @param model  Sparse HDC model with blocks, block_size, im_length and
+ *               cim_length set
+ * @return 0 on success, -1 on allocation failure
+ */
+static int init_sparse_item_memories(struct hdc_sparse_model* model)
+{
+    int blocks = model->blocks;
+    int block_size = model->block_size;
+    int maxl = model->cim_length - 1;
+
+    srand(1); /* Seed random number generator for predictable output */
+    model->im = malloc((size_t)model->im_length * blocks * sizeof(uint16_t));
+    if (!model->im) return -1;
+    model->cim = malloc((size_t)model->cim_length * blocks * sizeof(uint16_t));
+    if (!model->cim) return -1;
+    int* random_indices = malloc(blocks * sizeof(int));
+    if (!random_indices) return -1;
+
+    for (int ch = 0; ch < model->im_length; ch++)
+    {
+        gen_random_sparse_hv(model->im + (size_t)ch * blocks, blocks,
+                             block_size);
+    }
+    gen_random_sparse_hv(model->cim, blocks, block_size);
+    rand_perm(random_indices, blocks);
+    for (int i = 1; i <= maxl; i++)
+    {
+        uint16_t* hv = model->cim + (size_t)i * blocks;
+        memcpy(hv, hv - blocks, blocks * sizeof(uint16_t));
+        int start_index = (int)((long)(i - 1) * blocks / maxl);
+        int end_index = (int)((long)i * blocks / maxl);
+        for (int j = start_index; j < end_index; j++)
+        {
+            int b = random_indices[j];
+            hv[b] = (uint16_t)((hv[b] + 1 + rand() % (block_size - 1))
+                               % block_size);
+        }
+    }
+
+    free(random_indices);
+    return 0;
+}
+
+/**
+ * Trains a hyperdimensional computing model on block-sparse hypervectors of
+ * dimension BLOCKS x BLOCK_SIZE. Matches hdctrain, with class vectors kept as
+ * per-position counts of the bundled ngrams.
+ * @param label_train_set  Training set labels
+ * @param train_set        Training set data
+ * @param train_set_len    Length of training set
+ * @param num_classes      Number of classes
+ * @param blocks           Number of blocks
+ * @param block_size       Number of positions per block
+ * @param N                Size of Ngram
+ * @param maxl             Maximum amplitude of EMG signal
+ * @param precision        Precision used in quantization of input EMG signals
+ * @param cutting_angle    Threshold angle for not including a vector
+ * @return Trained sparse hyperdimensional computing model
+ */
+struct hdc_sparse_model* hdctrain_sparse(int* label_train_set,
+                                         double** train_set, int train_set_len,
+                                         int num_classes, int blocks,
+                                         int block_size, int N, int maxl,
+                                         double precision,
+                                         double cutting_angle)
+{
+    if (maxl < 1 || maxl >= HDC_MAX_LEVELS || block_size < 2
+        || block_size > 65536 || blocks < 1)
+    {
+        fprintf(stderr, "hdctrain_sparse: invalid maxl or block layout\n");
+        return NULL;
+    }
+
+    /* Initialize trained model */
+    struct hdc_sparse_model* model = calloc(1, sizeof(struct hdc_sparse_model));
+    if (!model) goto mem_error;
+    model->blocks = blocks;
+    model->block_size = block_size;
+    model->im_length = NUM_EMG_CHANNELS;
+    model->cim_length = maxl + 1;
+    model->num_classes = num_classes;
+    if (init_sparse_item_memories(model)) goto mem_error;
+    model->am = calloc((size_t)num_classes * blocks * block_size, sizeof(int));
+    if (!model->am) goto mem_error;
+    model->am_norms_sq = calloc(num_classes, sizeof(double));
+    if (!model->am_norms_sq) goto mem_error;
+    model->num_pat = calloc(num_classes, sizeof(int));
+    if (!model->num_pat) goto mem_error;
+
+    uint16_t* ngram = malloc(blocks * sizeof(uint16_t));
+    if (!ngram) goto mem_error;
+    uint16_t* record = malloc(blocks * sizeof(uint16_t));
+    if (!record) goto mem_error;
+    int channels = model->im_length;
+    hdc_level_t* levels =
+        malloc((size_t)train_set_len * channels * sizeof(hdc_level_t));
+    if (!levels) goto mem_error;
+    model->out_of_range =
+        quantize_block(levels, train_set, train_set_len, channels, precision,
+                       model->cim_length);
+
+    /* Train model */
+    size_t class_size = (size_t)blocks * block_size;
+    int i = 0;
+    while (i < train_set_len - N + 1)
+    {
+        int label = label_train_set[i + N - 1];
+        if (label_train_set[i] == label)
+        {
+            compute_sparse_ngram(ngram, record, levels + (size_t)i * channels,
+                                 model, N);
+            int* am = model->am + label * class_size;
+            double angle = sparse_similarity(am, model->am_norms_sq[label],
+                                             ngram, blocks, block_size);
+            /* An empty class vector has an undefined angle */
+            if (angle < cutting_angle || isnan(angle))
+            {
+                sparse_bundle(am, &model->am_norms_sq[label], ngram, blocks,
+                              block_size);
+                model->num_pat[label]++;
+            }
+            i++;
+        }
+        else
+        {
+            i += N - 1;
+        }
+    }
+
+    free(levels);
+    free(record);
+    free(ngram);
+
+    return model;
+
+mem_error:
+    fprintf(stderr, "hdctrain_sparse: failed to allocate memory\n");
+    return NULL;
+}
+
+/**
+ * Tests a sparse model. Implements hdcpredict_sparse, optionally reporting
+ * the label predicted for every window.
+ * @param predicted  If not NULL, receives the label predicted for each of the
+ *                   TEST_SET_LEN - N + 1 windows
+ * @return Accuracy of the sparse model
+ */
+static struct hdc_accuracy predict_sparse(struct hdc_sparse_model* model,
+                                          int* label_test_set,
+                                          double** test_set, int test_set_len,
+                                          int N, double precision,
+                                          int predicted[])
+{
+    int correct = 0;
+    int num_tests = 0;
+    int tranz_error = 0;
+    int blocks = model->blocks;
+
+    int* frequencies = malloc(model->num_classes * sizeof(int));
+    if (!frequencies) goto mem_error;
+    uint16_t* sig_hv = malloc(blocks * sizeof(uint16_t));
+    if (!sig_hv) goto mem_error;
+    uint16_t* record = malloc(blocks * sizeof(uint16_t));
+    if (!record) goto mem_error;
+    int channels = model->im_length;
+    hdc_level_t* levels =
+        malloc((size_t)test_set_len * channels * sizeof(hdc_level_t));
+    if (!levels) goto mem_error;
+    int out_of_range =
+        quantize_block(levels, test_set, test_set_len, channels, precision,
+                       model->cim_length);
+
+    for (int i = 0; i < test_set_len - N + 1; i++)
+    {
+        num_tests++;
+        int actual_label = window_label(label_test_set + i, N, frequencies,
+                                        model->num_classes);
+
+        compute_sparse_ngram(sig_hv, record, levels + (size_t)i * channels,
+                             model, N);
+        struct hdc_prediction prediction;
+        int predict_label = search_sparse(model, sig_hv, 1, &prediction);
+        if (predicted) predicted[i] = predict_label;
+
+        if (predict_label == actual_label)
+        {
+            correct++;
+        }
+        else if (label_test_set[i] != label_test_set[i + N - 1])
+        {
+            tranz_error++;
+        }
+    }
+
+    free(levels);
+    free(record);
+    free(sig_hv);
+    free(frequencies);
+
+    return hdcaccuracy(correct, tranz_error, num_tests, out_of_range);
+
+mem_error:
+    fprintf(stderr, "predict_sparse: failed to allocate memory\n");
+    return failed_accuracy;
+}
+
+/**
+ * Tests a sparse hyperdimensional computing model.
+ * @param model           Trained sparse HDC model
+ * @param label_test_set  Test set labels
+ * @param test_set        Test set data
+ * @param test_set_len    Length of test set
+ * @param N               Size of Ngram
+ * @param precision       Precision used in quantization of input EMG signals
+ * @return Accuracy of the sparse model
+ */
+struct hdc_accuracy hdcpredict_sparse(struct hdc_sparse_model* model,
+                                      int* label_test_set, double** test_set,
+                                      int test_set_len, int N,
+                                      double precision)
+{
+    return predict_sparse(model, label_test_set, test_set, test_set_len, N,
+                          precision, NULL);
+}
+
+/**
+ * Frees memory allocated for a sparse HDC model.
+ * @param model  Model allocated by hdctrain_sparse
+ */
+void hdcdeinit_sparse(struct hdc_sparse_model* model)
+{
+    free(model->num_pat);
+    free(model->am_norms_sq);
+    free(model->am);
+    free(model->cim);
+    free(model->im);
+    free(model);
+}
+
+/**
+ * Frees memory allocated for HDC model
+ * @param model  Model allocated by hdctrain
+ */
+void hdcdeinit(struct hdc_trained_model* model)
+{
+    free(model->num_pat);
+    for (int i = 0; i < model->num_classes; i++)
+    {
+        free(model->am[i]);
+    }
+    free(model->am);
+    deinit_item_memories(model->item_memories);
+    free(model);
+}
+
+/* Model to classify windows with and scratch buffers sized for it, allocated
+ * once so that classifying a window does not allocate. Exactly one of dense,
+ * compressed and sparse is set; index is set on top of compressed. */
+struct hdc_classifier
+{
+    struct hdc_trained_model* dense;
+    struct hdc_compressed_model* compressed;
+    struct hdc_am_index* index;
+    struct hdc_sparse_model* sparse;
+    struct hdc_item_memories* item_memories;
+    const struct hdc_kernels* kernels;
+    int D;
+    int N;
+    int nprobe;
+    int channels;
+    int cim_length;
+    hdc_level_t* levels;     /* N x channels */
+    double* sig_hv;          /* D, dense and compressed */
+    double* record;          /* D, dense and compressed */
+    uint64_t* query;         /* words, compressed */
+    int* probes;             /* num_lists, indexed */
+    int* distances;          /* num_lists, indexed */
+    uint16_t* sparse_hv;     /* blocks, sparse */
+    uint16_t* sparse_record; /* blocks, sparse */
+    int num_classes;
+    int* frequencies;        /* num_classes, for hdcpredict_classifier */
+};
+
+/**
+ * Frees a classifier and its scratch buffers. The model is not freed.
+ * @param classifier  Classifier allocated by one of the hdcclassifier
+ *                    functions
+ */
+void hdcdeinit_classifier(struct hdc_classifier* classifier)
+{
+    free(classifier->sparse_record);
+    free(classifier->sparse_hv);
+    free(classifier->distances);
+    free(classifier->probes);
+    free(classifier->query);
+    free(classifier->record);
+    free(classifier->sig_hv);
+    free(classifier->levels);
+    free(classifier->frequencies);
+    free(classifier);
+}
+
+/**
+ * Allocates a classifier for one of the model kinds.
+ * @param dense       Trained model, or NULL
+ * @param compressed  Compressed model, or NULL
+ * @param index       Index over COMPRESSED, or NULL
+ * @param nprobe      Number of index lists to search
+ * @param sparse      Sparse model, or NULL
+ * @param D           Dimension of hypervectors; ignored for sparse models
+ * @param N           Size of Ngram
+ * @return Classifier, or NULL on allocation failure
+ */
+static struct hdc_classifier* init_classifier(
+    struct hdc_trained_model* dense, struct hdc_compressed_model* compressed,
+    struct hdc_am_index* index, int nprobe, struct hdc_sparse_model* sparse,
+    int D, int N)
+{
+    struct hdc_classifier* classifier = calloc(1, sizeof(*classifier));
+    if (!classifier) goto mem_error;
+    classifier->dense = dense;
+    classifier->compressed = compressed;
+    classifier->index = index;
+    classifier->sparse = sparse;
+    classifier->D = D;
+    classifier->N = N;
+    classifier->nprobe = nprobe;
+
+    if (sparse)
+    {
+        classifier->channels = sparse->im_length;
+        classifier->cim_length = sparse->cim_length;
+        classifier->sparse_hv = malloc(sparse->blocks * sizeof(uint16_t));
+        if (!classifier->sparse_hv) goto mem_error;
+        classifier->sparse_record = malloc(sparse->blocks * sizeof(uint16_t));
+        if (!classifier->sparse_record) goto mem_error;
+    }
+    else
+    {
+        classifier->item_memories = dense ? dense->item_memories
+                                          : compressed->item_memories;
+        classifier->channels = classifier->item_memories->im_length;
+        classifier->cim_length = classifier->item_memories->cim_length;
+        classifier->kernels = select_kernels(D, N, classifier->channels);
+        classifier->sig_hv = malloc(D * sizeof(double));
+        if (!classifier->sig_hv) goto mem_error;
+        classifier->record = malloc(D * sizeof(double));
+        if (!classifier->record) goto mem_error;
+    }
+    if (compressed)
+    {
+        classifier->query = malloc(compressed->words * sizeof(uint64_t));
+        if (!classifier->query) goto mem_error;
+    }
+    if (index)
+    {
+        classifier->probes = malloc(index->num_lists * sizeof(int));
+        if (!classifier->probes) goto mem_error;
+        classifier->distances = malloc(index->num_lists * sizeof(int));
+        if (!classifier->distances) goto mem_error;
+    }
+    classifier->levels = malloc((size_t)N * classifier->channels
+                                * sizeof(hdc_level_t));
+    if (!classifier->levels) goto mem_error;
+    classifier->num_classes = sparse ? sparse->num_classes
+        : dense ? dense->num_classes : compressed->num_classes;
+    classifier->frequencies = malloc(classifier->num_classes * sizeof(int));
+    if (!classifier->frequencies) goto mem_error;
+    return classifier;
+
+mem_error:
+    fprintf(stderr, "init_classifier: failed to allocate memory\n");
+    if (classifier) hdcdeinit_classifier(classifier);
+    return NULL;
+}
+
+/**
+ * Creates a classifier that searches the full-precision associative memory.
+ * @param model  Trained HDC model
+ * @param D      Dimension of hypervectors
+ * @param N      Size of Ngram
+ * @return Classifier for hdcclassify, or NULL on allocation failure
+ */
+struct hdc_classifier* hdcclassifier(struct hdc_trained_model* model, int D,
+                                     int N)
+{
+    return init_classifier(model, NULL, NULL, 0, NULL, D, N);
+}
+
+/**
+ * Creates a classifier that scans a compressed associative memory.
+ * @param model  Compressed HDC model
+ * @param N      Size of Ngram
+ * @return Classifier for hdcclassify, or NULL on allocation failure
+ */
+struct hdc_classifier* hdcclassifier_compressed(
+    struct hdc_compressed_model* model, int N)
+{
+    return init_classifier(NULL, model, NULL, 0, NULL, model->D, N);
+}
+
+/**
+ * Creates a classifier that searches a compressed associative memory through
+ * its index. The top list and margin only cover the probed classes.
+ * @param index   Index built by hdcindex
+ * @param nprobe  Number of closest lists to search
+ * @param N       Size of Ngram
+ * @return Classifier for hdcclassify, or NULL on allocation failure
+ */
+struct hdc_classifier* hdcclassifier_indexed(struct hdc_am_index* index,
+                                             int nprobe, int N)
+{
+    return init_classifier(NULL, index->model, index, nprobe, NULL,
+                           index->model->D, N);
+}
+
+/**
+ * Creates a classifier for a sparse model.
+ * @param model  Trained sparse HDC model
+ * @param N      Size of Ngram
+ * @return Classifier for hdcclassify, or NULL on allocation failure
+ */
+struct hdc_classifier* hdcclassifier_sparse(struct hdc_sparse_model* model,
+                                            int N)
+{
+    return init_classifier(NULL, NULL, NULL, 0, model, 0, N);
+}
+
+/**
+ * Searches the model of CLASSIFIER for the window quantized into its levels.
+ * @param classifier  Classifier with the window in CLASSIFIER->levels
+ * @param k           Number of labels to report, from 1 to HDC_MAX_TOP_K
+ * @param prediction  Receives the top K labels, similarities and margin
+ * @return 0 on success, -1 if the ngram cannot be computed
+ */
+static int classify_levels(struct hdc_classifier* classifier, int k,
+                           struct hdc_prediction* prediction)
+{
+    int N = classifier->N;
+    if (classifier->sparse)
+    {
+        compute_sparse_ngram(classifier->sparse_hv, classifier->sparse_record,
+                             classifier->levels, classifier->sparse, N);
+        search_sparse(classifier->sparse, classifier->sparse_hv, k,
+                      prediction);
+        return 0;
+    }
+
+    int D = classifier->D;
+    if (classifier->kernels->ngram(classifier->sig_hv, classifier->record,
+                                   classifier->levels,
+                                   classifier->item_memories, D, N) != 0)
+    {
+        return -1;
+    }
+    if (classifier->dense)
+    {
+        search_top_k(classifier->dense, classifier->sig_hv, D,
+                     classifier->kernels, k, prediction);
+        return 0;
+    }
+    pack_signs(classifier->query, classifier->sig_hv, classifier->compressed);
+    if (classifier->index)
+    {
+        search_index(classifier->index, classifier->query, classifier->nprobe,
+                     classifier->probes, classifier->distances, k,
+                     prediction);
+    }
+    else
+    {
+        search_compressed(classifier->compressed, classifier->query, k,
+                          prediction);
+    }
+    return 0;
+}
+
+/**
+ * Classifies a single window with the K best labels and a confidence margin,
+ * using the buffers of CLASSIFIER instead of allocating.
+ * @param classifier     Classifier created for the model to search
+ * @param window         N consecutive samples
+ * @param precision      Precision used in quantization of input EMG signals
+ * @param k              Number of labels to report, from 1 to HDC_MAX_TOP_K
+ * @param reject_margin  Minimum similarity margin between the best and the
+ *                       second best class for the window to be accepted
+ * @param prediction     Receives the top K labels, similarities and margin
+ * @return Best label, HDC_REJECTED if the margin is below REJECT_MARGIN or no
+ *         class has been trained, or -1 on error
+ */
+int hdcclassify(struct hdc_classifier* classifier, double** window,
+                double precision, int k, double reject_margin,
+                struct hdc_prediction* prediction)
+{
+    if (k < 1 || k > HDC_MAX_TOP_K)
+    {
+        fprintf(stderr, "hdcclassify: k must be between 1 and %d\n",
+                HDC_MAX_TOP_K);
+        return -1;
+    }
+
+    quantize_block(classifier->levels, window, classifier->N,
+                   classifier->channels, precision, classifier->cim_length);
+    if (classify_levels(classifier, k, prediction)) return -1;
+
+    if (prediction->k == 0 || prediction->margin < reject_margin)
+    {
+        prediction->rejected = 1;
+        return HDC_REJECTED;
+    }
+    return prediction->labels[0];
+}
+
+/**
+ * Tests a model through CLASSIFIER without allocating, so a caller running
+ * many small batches, such as a pinned worker, can reuse its buffers. Every
+ * window is classified on its own like in hdcpredict; each sample is
+ * quantized once as the window slides over it.
+ * @param classifier      Classifier created for the model to test
+ * @param label_test_set  Test set labels
+ * @param test_set        Test set data
+ * @param test_set_len    Length of test set
+ * @param precision       Precision used in quantization of input EMG signals
+ * @return Accuracy of the model
+ */
+struct hdc_accuracy hdcpredict_classifier(struct hdc_classifier* classifier,
+                                          int* label_test_set,
+                                          double** test_set, int test_set_len,
+                                          double precision)
+{
+    int correct = 0;
+    int num_tests = 0;
+    int tranz_error = 0;
+    int out_of_range = 0;
+    int N = classifier->N;
+    int channels = classifier->channels;
+    hdc_level_t* levels = classifier->levels;
+    struct hdc_prediction prediction;
+
+    for (int i = 0; i < test_set_len - N + 1; i++)
+    {
+        if (i == 0)
+        {
+            out_of_range += quantize_block(levels, test_set, N, channels,
+                                           precision, classifier->cim_length);
+        }
+        else
+        {
+            memmove(levels, levels + channels,
+                    (size_t)(N - 1) * channels * sizeof(hdc_level_t));
+            out_of_range += quantize_block(
+                levels + (size_t)(N - 1) * channels, test_set + i + N - 1, 1,
+                channels, precision, classifier->cim_length);
+        }
+        num_tests++;
+        int actual_label = window_label(label_test_set + i, N,
+                                        classifier->frequencies,
+                                        classifier->num_classes);
+        int predict_label =
+            classify_levels(classifier, 1, &prediction) == 0
+                && prediction.k > 0 ? prediction.labels[0] : -1;
+
+        if (predict_label == actual_label)
+        {
+            correct++;
+        }
+        else if (label_test_set[i] != label_test_set[i + N - 1])
+        {
+            tranz_error++;
+        }
+    }
+
+    return hdcaccuracy(correct, tranz_error, num_tests, out_of_range);
 }
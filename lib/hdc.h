@@ -1,5 +1,8 @@
  #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+
 struct hdc_item_memories
 {
     double** cim;
@@ -14,20 +17,144 @@ struct hdc_trained_model
     double** am;
     int num_classes;
     int* num_pat;
+    int out_of_range; /* training samples clamped to the CiM */
+};
+
+struct hdc_compressed_model
+{
+    struct hdc_item_memories* item_memories;
+    int num_classes;
+    int D;
+    int num_dims;     /* kept dimensions */
+    int* dims;        /* indices of kept dimensions, ascending */
+    int bits;         /* bit-planes per class vector */
+    int words;        /* 64-bit words per bit-plane */
+    uint64_t* planes; /* num_classes x bits x words */
+    double* norms;    /* norm of each quantized class vector */
+    size_t bytes;     /* total size of the compressed model */
+};
+
+struct hdc_am_index
+{
+    struct hdc_compressed_model* model;
+    int num_lists;
+    uint64_t* centroids; /* num_lists x words, majority sign of each list */
+    int* list_offsets;   /* num_lists + 1 offsets into list_labels */
+    int* list_labels;    /* class labels grouped by list */
+};
+
+#define HDC_SPARSE_MAX_CHANNELS 16
+
+/* Model on block-sparse hypervectors: each vector is stored as the active
+ * position of each of its blocks */
+struct hdc_sparse_model
+{
+    int blocks;
+    int block_size;
+    uint16_t* cim;       /* cim_length x blocks */
+    int cim_length;
+    uint16_t* im;        /* im_length x blocks */
+    int im_length;
+    int* am;             /* num_classes x blocks x block_size counts */
+    double* am_norms_sq; /* squared norm of each class vector */
+    int num_classes;
+    int* num_pat;
+    int out_of_range;    /* training samples clamped to the CiM */
+};
+
+#define HDC_MAX_TOP_K 8
+#define HDC_REJECTED -2 /* margin below the rejection threshold */
+
+struct hdc_prediction
+{
+    int k; /* number of valid entries in labels and similarities */
+    int labels[HDC_MAX_TOP_K];
+    double similarities[HDC_MAX_TOP_K];
+    double margin; /* best minus second best similarity */
+    int rejected;
 };
 
 struct hdc_accuracy
 {
     double accuracy;
     double acc_exc_trnz;
+    int out_of_range; /* test samples clamped to the CiM */
+    int num_tests;    /* windows tested */
+    int correct;      /* windows predicted correctly */
+    int tranz_error;  /* wrong predictions on windows spanning a transition */
 };
 
 struct hdc_trained_model* hdctrain(int* label_train_set, double** train_set,
-                                   int num_classes, int D, int N, int maxl,
-                                   double precision, double cutting_angle);
+                                   int train_set_len, int num_classes, int D,
+                                   int N, int maxl, double precision,
+                                   double cutting_angle);
 
 struct hdc_accuracy hdcpredict(struct hdc_trained_model* model,
                                int* label_test_set, double** test_set,
                                int test_set_len, int D, int N, double precision);
 
+struct hdc_accuracy hdcaccuracy(int correct, int tranz_error, int num_tests,
+                                int out_of_range);
+
 void hdcdeinit(struct hdc_trained_model* model);
+
+struct hdc_compressed_model* hdccompress(struct hdc_trained_model* model, int D,
+                                         int bits, double keep_fraction);
+
+struct hdc_accuracy hdcpredict_compressed(struct hdc_compressed_model* model,
+                                          int* label_test_set,
+                                          double** test_set, int test_set_len,
+                                          int N, double precision);
+
+void hdcdeinit_compressed(struct hdc_compressed_model* model);
+
+struct hdc_am_index* hdcindex(struct hdc_compressed_model* model, int num_lists,
+                              int iterations);
+
+struct hdc_accuracy hdcpredict_indexed(struct hdc_am_index* index, int nprobe,
+                                       int* label_test_set, double** test_set,
+                                       int test_set_len, int N,
+                                       double precision);
+
+void hdcdeinit_index(struct hdc_am_index* index);
+
+struct hdc_sparse_model* hdctrain_sparse(int* label_train_set,
+                                         double** train_set, int train_set_len,
+                                         int num_classes, int blocks,
+                                         int block_size, int N, int maxl,
+                                         double precision,
+                                         double cutting_angle);
+
+struct hdc_accuracy hdcpredict_sparse(struct hdc_sparse_model* model,
+                                      int* label_test_set, double** test_set,
+                                      int test_set_len, int N,
+                                      double precision);
+
+void hdcdeinit_sparse(struct hdc_sparse_model* model);
+
+/* Classifies one window at a time against any model kind, reusing buffers
+ * allocated when it is created */
+struct hdc_classifier;
+
+struct hdc_classifier* hdcclassifier(struct hdc_trained_model* model, int D,
+                                     int N);
+
+struct hdc_classifier* hdcclassifier_compressed(
+    struct hdc_compressed_model* model, int N);
+
+struct hdc_classifier* hdcclassifier_indexed(struct hdc_am_index* index,
+                                             int nprobe, int N);
+
+struct hdc_classifier* hdcclassifier_sparse(struct hdc_sparse_model* model,
+                                            int N);
+
+int hdcclassify(struct hdc_classifier* classifier, double** window,
+                double precision, int k, double reject_margin,
+                struct hdc_prediction* prediction);
+
+struct hdc_accuracy hdcpredict_classifier(struct hdc_classifier* classifier,
+                                          int* label_test_set,
+                                          double** test_set, int test_set_len,
+                                          double precision);
+
+void hdcdeinit_classifier(struct hdc_classifier* classifier);
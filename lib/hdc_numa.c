@@ -0,0 +1,477 @@
+#define _GNU_SOURCE
+#include "hdc_numa.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_NUMA_NODES 64
+
+/**
+ * Parses a kernel CPU list such as "0-3,8,10-11".
+ * @param list      CPU list
+ * @param cpus      Array to append the listed CPUs to
+ * @param max_cpus  Capacity of CPUS
+ * @return Number of CPUs parsed
+ */
+static int parse_cpulist(const char* list, int cpus[], int max_cpus)
+{
+    int count = 0;
+    const char* p = list;
+    while (*p && *p != '\n')
+    {
+        char* end;
+        long first = strtol(p, &end, 10);
+        if (end == p) break;
+        long last = first;
+        p = end;
+        if (*p == '-')
+        {
+            last = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for (long cpu = first; cpu <= last && count < max_cpus; cpu++)
+        {
+            cpus[count++] = (int)cpu;
+        }
+        if (*p == ',') p++;
+    }
+    return count;
+}
+
+/**
+ * Removes the CPUs that are not in ALLOWED, keeping the order of the rest.
+ * @param cpus     CPUs to filter in place
+ * @param count    Number of CPUs
+ * @param allowed  CPUs the process may run on
+ * @return Number of CPUs kept
+ */
+static int filter_allowed(int cpus[], int count, const cpu_set_t* allowed)
+{
+    int kept = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (cpus[i] >= 0 && cpus[i] < CPU_SETSIZE
+            && CPU_ISSET(cpus[i], allowed))
+        {
+            cpus[kept++] = cpus[i];
+        }
+    }
+    return kept;
+}
+
+/**
+ * Reads the NUMA nodes and their CPUs from sysfs, keeping only the CPUs in
+ * the affinity mask of the process, so that taskset and cpusets are honoured.
+ * Nodes left without CPUs are dropped. Without NUMA information all allowed
+ * CPUs form a single node.
+ * @param pool  Pool to store the topology in
+ * @return 0 on success, -1 on allocation failure
+ */
+static int read_topology(struct hdc_numa_pool* pool)
+{
+    int max_cpus = CPU_SETSIZE;
+    pool->node_ids = malloc(MAX_NUMA_NODES * sizeof(int));
+    if (!pool->node_ids) return -1;
+    pool->cpu_offsets = malloc((MAX_NUMA_NODES + 1) * sizeof(int));
+    if (!pool->cpu_offsets) return -1;
+    pool->cpus = malloc(max_cpus * sizeof(int));
+    if (!pool->cpus) return -1;
+
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    {
+        /* Without the mask, assume every CPU is allowed */
+        memset(&allowed, 0xff, sizeof(allowed));
+    }
+
+    int num_cpus = 0;
+    pool->num_nodes = 0;
+    for (int node = 0; node < MAX_NUMA_NODES; node++)
+    {
+        char path[64];
+        char list[4096];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist",
+                 node);
+        FILE* file = fopen(path, "r");
+        if (!file) continue;
+        int got_list = fgets(list, sizeof(list), file) != NULL;
+        fclose(file);
+        if (!got_list) continue;
+
+        int found = parse_cpulist(list, pool->cpus + num_cpus,
+                                  max_cpus - num_cpus);
+        found = filter_allowed(pool->cpus + num_cpus, found, &allowed);
+        if (found == 0) continue; /* memory-only or disallowed node */
+        pool->node_ids[pool->num_nodes] = node;
+        pool->cpu_offsets[pool->num_nodes] = num_cpus;
+        pool->num_nodes++;
+        num_cpus += found;
+    }
+
+    if (pool->num_nodes == 0)
+    {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        int count = online > 0 && online < max_cpus ? (int)online : 1;
+        for (int cpu = 0; cpu < count; cpu++)
+        {
+            pool->cpus[cpu] = cpu;
+        }
+        num_cpus = filter_allowed(pool->cpus, count, &allowed);
+        if (num_cpus == 0)
+        {
+            pool->cpus[0] = 0;
+            num_cpus = 1;
+        }
+        pool->node_ids[0] = 0;
+        pool->cpu_offsets[0] = 0;
+        pool->num_nodes = 1;
+    }
+    pool->cpu_offsets[pool->num_nodes] = num_cpus;
+    return 0;
+}
+
+/**
+ * Pins the calling thread to CPU. Failure is not fatal, as the thread still
+ * runs correctly, only without the placement guarantee.
+ * @param cpu  CPU to run on
+ */
+static void pin_to_cpu(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+    {
+        fprintf(stderr, "pin_to_cpu: cannot pin thread to CPU %d\n", cpu);
+    }
+}
+
+/**
+ * Allocates a copy of VEC on the calling thread.
+ * @param vec   Vector to copy
+ * @param size  Size of VEC in bytes
+ * @return Copy of VEC (heap-allocated)
+ */
+static void* copy_vector(const void* vec, size_t size)
+{
+    void* copy = malloc(size);
+    if (copy) memcpy(copy, vec, size);
+    return copy;
+}
+
+/**
+ * Deep-copies a trained model. Every page of the copy is first written by the
+ * calling thread, so it is placed on that thread's NUMA node.
+ * @param model  Trained HDC model
+ * @param D      Dimension of hypervectors
+ * @return Copy of MODEL, to be freed with hdcdeinit
+ */
+static struct hdc_trained_model* replicate_model(
+    struct hdc_trained_model* model, int D)
+{
+    struct hdc_item_memories* memories = model->item_memories;
+    struct hdc_trained_model* replica =
+        copy_vector(model, sizeof(struct hdc_trained_model));
+    if (!replica) goto mem_error;
+    replica->item_memories =
+        copy_vector(memories, sizeof(struct hdc_item_memories));
+    if (!replica->item_memories) goto mem_error;
+    replica->item_memories->cim =
+        malloc(memories->cim_length * sizeof(double*));
+    if (!replica->item_memories->cim) goto mem_error;
+    for (int i = 0; i < memories->cim_length; i++)
+    {
+        replica->item_memories->cim[i] =
+            copy_vector(memories->cim[i], D * sizeof(double));
+        if (!replica->item_memories->cim[i]) goto mem_error;
+    }
+    replica->item_memories->im = malloc(memories->im_length * sizeof(double*));
+    if (!replica->item_memories->im) goto mem_error;
+    for (int i = 0; i < memories->im_length; i++)
+    {
+        replica->item_memories->im[i] =
+            copy_vector(memories->im[i], D * sizeof(double));
+        if (!replica->item_memories->im[i]) goto mem_error;
+    }
+    replica->am = malloc(model->num_classes * sizeof(double*));
+    if (!replica->am) goto mem_error;
+    for (int i = 0; i < model->num_classes; i++)
+    {
+        replica->am[i] = copy_vector(model->am[i], D * sizeof(double));
+        if (!replica->am[i]) goto mem_error;
+    }
+    replica->num_pat = copy_vector(model->num_pat,
+                                   model->num_classes * sizeof(int));
+    if (!replica->num_pat) goto mem_error;
+
+    return replica;
+
+mem_error:
+    fprintf(stderr, "replicate_model: failed to allocate memory\n");
+    return NULL;
+}
+
+struct replicate_job
+{
+    struct hdc_numa_pool* pool;
+    struct hdc_trained_model* model;
+    int node;
+};
+
+static void* replicate_worker(void* arg)
+{
+    struct replicate_job* job = arg;
+    pin_to_cpu(job->pool->cpus[job->pool->cpu_offsets[job->node]]);
+    job->pool->replicas[job->node] = replicate_model(job->model, job->pool->D);
+    return NULL;
+}
+
+/**
+ * Creates a pool with one replica of MODEL per NUMA node. MODEL is not
+ * referenced after this returns.
+ * @param model  Trained HDC model
+ * @param D      Dimension of hypervectors
+ * @return Pool of replicas
+ */
+struct hdc_numa_pool* hdc_numa_pool_create(struct hdc_trained_model* model,
+                                           int D)
+{
+    struct hdc_numa_pool* pool = calloc(1, sizeof(struct hdc_numa_pool));
+    if (!pool) goto mem_error;
+    pool->D = D;
+    if (read_topology(pool)) goto mem_error;
+    pool->replicas = calloc(pool->num_nodes,
+                            sizeof(struct hdc_trained_model*));
+    if (!pool->replicas) goto mem_error;
+
+    struct replicate_job jobs[MAX_NUMA_NODES];
+    pthread_t threads[MAX_NUMA_NODES];
+    for (int node = 0; node < pool->num_nodes; node++)
+    {
+        jobs[node].pool = pool;
+        jobs[node].model = model;
+        jobs[node].node = node;
+        if (pthread_create(&threads[node], NULL, replicate_worker,
+                           &jobs[node]) != 0)
+        {
+            /* Replicate on the calling thread, without placement */
+            pool->replicas[node] = replicate_model(model, D);
+            threads[node] = pthread_self();
+        }
+    }
+    int failed = 0;
+    for (int node = 0; node < pool->num_nodes; node++)
+    {
+        if (!pthread_equal(threads[node], pthread_self()))
+        {
+            pthread_join(threads[node], NULL);
+        }
+        failed |= pool->replicas[node] == NULL;
+    }
+    if (failed) goto mem_error;
+
+    return pool;
+
+mem_error:
+    fprintf(stderr, "hdc_numa_pool_create: failed to allocate memory\n");
+    return NULL;
+}
+
+/* State shared by the workers of one hdc_numa_predict call */
+struct predict_shared
+{
+    pthread_mutex_t lock;
+    int next_job;
+    int num_jobs;
+    int job_windows;
+    int num_windows;
+    int* label_test_set;
+    double** test_set;
+    int N;
+    double precision;
+    int D;
+    int correct;
+    int tranz_error;
+    int num_tests;
+    int out_of_range;
+    int failed;
+};
+
+struct predict_worker
+{
+    struct predict_shared* shared;
+    struct hdc_trained_model* replica;
+    int cpu;
+};
+
+static void* predict_worker(void* arg)
+{
+    struct predict_worker* worker = arg;
+    struct predict_shared* shared = worker->shared;
+    pin_to_cpu(worker->cpu);
+
+    /* Allocated after pinning so first-touch puts the scratch on this node */
+    struct hdc_classifier* classifier =
+        hdcclassifier(worker->replica, shared->D, shared->N);
+    if (!classifier)
+    {
+        pthread_mutex_lock(&shared->lock);
+        shared->failed = 1;
+        pthread_mutex_unlock(&shared->lock);
+        return NULL;
+    }
+
+    for (;;)
+    {
+        pthread_mutex_lock(&shared->lock);
+        int job = shared->next_job++;
+        pthread_mutex_unlock(&shared->lock);
+        if (job >= shared->num_jobs) break;
+
+        int start = job * shared->job_windows;
+        int windows = shared->num_windows - start;
+        if (windows > shared->job_windows) windows = shared->job_windows;
+        struct hdc_accuracy accuracy =
+            hdcpredict_classifier(classifier, shared->label_test_set + start,
+                                  shared->test_set + start,
+                                  windows + shared->N - 1, shared->precision);
+
+        pthread_mutex_lock(&shared->lock);
+        shared->num_tests += accuracy.num_tests;
+        shared->correct += accuracy.correct;
+        shared->tranz_error += accuracy.tranz_error;
+        shared->out_of_range += accuracy.out_of_range;
+        pthread_mutex_unlock(&shared->lock);
+    }
+
+    hdcdeinit_classifier(classifier);
+    return NULL;
+}
+
+/**
+ * Runs hdc_numa_predict with a choice of replica. Remote routing exists only
+ * so that bench_hdc_numa can measure the cost of cross-node access.
+ * @param remote  If nonzero, route every job to the replica of the next node
+ *                instead of the local one
+ * @return Accuracy over the whole test set
+ */
+static struct hdc_accuracy numa_predict(struct hdc_numa_pool* pool,
+                                        int* label_test_set, double** test_set,
+                                        int test_set_len, int N,
+                                        double precision, int workers_per_node,
+                                        int job_windows, int remote)
+{
+    struct hdc_accuracy failed_accuracy = { -1.0, -1.0 };
+    struct predict_shared shared;
+    memset(&shared, 0, sizeof(shared));
+    shared.num_windows = test_set_len - N + 1;
+    if (shared.num_windows <= 0 || job_windows <= 0) return failed_accuracy;
+    shared.job_windows = job_windows;
+    shared.num_jobs = (shared.num_windows + job_windows - 1) / job_windows;
+    shared.label_test_set = label_test_set;
+    shared.test_set = test_set;
+    shared.N = N;
+    shared.precision = precision;
+    shared.D = pool->D;
+    pthread_mutex_init(&shared.lock, NULL);
+
+    int num_cpus = pool->cpu_offsets[pool->num_nodes];
+    struct predict_worker* workers =
+        malloc(num_cpus * sizeof(struct predict_worker));
+    if (!workers) goto mem_error;
+    pthread_t* threads = malloc(num_cpus * sizeof(pthread_t));
+    if (!threads) goto mem_error;
+
+    int num_workers = 0;
+    for (int node = 0; node < pool->num_nodes; node++)
+    {
+        int replica_node = remote ? (node + 1) % pool->num_nodes : node;
+        int first = pool->cpu_offsets[node];
+        int count = pool->cpu_offsets[node + 1] - first;
+        if (workers_per_node > 0 && workers_per_node < count)
+        {
+            count = workers_per_node;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            struct predict_worker* worker = &workers[num_workers];
+            worker->shared = &shared;
+            worker->replica = pool->replicas[replica_node];
+            worker->cpu = pool->cpus[first + i];
+            if (pthread_create(&threads[num_workers], NULL, predict_worker,
+                               worker) == 0)
+            {
+                num_workers++;
+            }
+        }
+    }
+    if (num_workers == 0)
+    {
+        /* Run the jobs on the calling thread */
+        workers[0].shared = &shared;
+        workers[0].replica = pool->replicas[0];
+        workers[0].cpu = pool->cpus[0];
+        predict_worker(&workers[0]);
+    }
+    for (int i = 0; i < num_workers; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    free(workers);
+    pthread_mutex_destroy(&shared.lock);
+    if (shared.failed) return failed_accuracy;
+
+    return hdcaccuracy(shared.correct, shared.tranz_error, shared.num_tests,
+                       shared.out_of_range);
+
+mem_error:
+    fprintf(stderr, "numa_predict: failed to allocate memory\n");
+    free(workers);
+    pthread_mutex_destroy(&shared.lock);
+    return failed_accuracy;
+}
+
+/**
+ * Tests a hyperdimensional computing model on all NUMA nodes. The test set is
+ * split into jobs of JOB_WINDOWS windows, which pinned workers take in turn
+ * and run against the replica of their own node.
+ * @param pool              Pool of replicas
+ * @param label_test_set    Test set labels
+ * @param test_set          Test set data
+ * @param test_set_len      Length of test set
+ * @param N                 Size of Ngram
+ * @param precision         Precision used in quantization of input EMG signals
+ * @param workers_per_node  Workers per node, or 0 for one per allowed CPU
+ * @param job_windows       Windows per job
+ * @return Accuracy over the whole test set. Samples shared by neighbouring
+ *         jobs are counted once per job in out_of_range.
+ */
+struct hdc_accuracy hdc_numa_predict(struct hdc_numa_pool* pool,
+                                     int* label_test_set, double** test_set,
+                                     int test_set_len, int N, double precision,
+                                     int workers_per_node, int job_windows)
+{
+    return numa_predict(pool, label_test_set, test_set, test_set_len, N,
+                        precision, workers_per_node, job_windows, 0);
+}
+
+/**
+ * Frees a pool and all of its replicas.
+ * @param pool  Pool allocated by hdc_numa_pool_create
+ */
+void hdc_numa_pool_destroy(struct hdc_numa_pool* pool)
+{
+    for (int node = 0; node < pool->num_nodes; node++)
+    {
+        hdcdeinit(pool->replicas[node]);
+    }
+    free(pool->replicas);
+    free(pool->cpus);
+    free(pool->cpu_offsets);
+    free(pool->node_ids);
+    free(pool);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "hdc.h"
+
+/*
+ * NUMA-aware inference. A pool keeps one replica of a trained model per NUMA
+ * node, built by a thread pinned to that node so first-touch places its pages
+ * in local memory. Prediction runs workers pinned to the CPUs of every node,
+ * each reading only the replica of its own node. Only CPUs in the affinity
+ * mask of the process are used.
+ */
+
+struct hdc_numa_pool
+{
+    int num_nodes;
+    int* node_ids;         /* kernel id of each node */
+    int* cpu_offsets;      /* num_nodes + 1 offsets into cpus */
+    int* cpus;             /* allowed CPUs grouped by node */
+    struct hdc_trained_model** replicas; /* one per node */
+    int D;
+};
+
+struct hdc_numa_pool* hdc_numa_pool_create(struct hdc_trained_model* model,
+                                           int D);
+
+struct hdc_accuracy hdc_numa_predict(struct hdc_numa_pool* pool,
+                                     int* label_test_set, double** test_set,
+                                     int test_set_len, int N, double precision,
+                                     int workers_per_node, int job_windows);
+
+void hdc_numa_pool_destroy(struct hdc_numa_pool* pool);
@@ -0,0 +1,471 @@
+#include "hdc_static.h"
+#include <string.h>
+
+#define HDC_STATIC_ALIGN 8
+
+/**
+ * Generates the next number of a xorshift sequence. Used instead of rand()
+ * so that item memories do not depend on the C library.
+ * @param state  Generator state, advanced in place
+ * @return Pseudo-random 32-bit number
+ */
+static uint32_t next_random(uint32_t* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/**
+ * Rounds SIZE up to the buffer alignment.
+ * @param size  Size in bytes
+ * @return Aligned size in bytes
+ */
+static size_t align_size(size_t size)
+{
+    return (size + HDC_STATIC_ALIGN - 1) & ~(size_t)(HDC_STATIC_ALIGN - 1);
+}
+
+/**
+ * Calculates the integer square root of VALUE.
+ * @param value  Input value
+ * @return Largest integer whose square is at most VALUE
+ */
+static uint64_t isqrt(uint64_t value)
+{
+    uint64_t root = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+    while (bit > value)
+    {
+        bit >>= 2;
+    }
+    while (bit != 0)
+    {
+        if (value >= root + bit)
+        {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else
+        {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+/**
+ * Calculates the cosine similarity of OP1 and OP2 in Q15 fixed point.
+ * @param op1  First operand
+ * @param op2  Second operand
+ * @param len  Length of vectors
+ * @return Cosine similarity scaled by HDC_SIM_ONE, or HDC_SIM_UNDEFINED if
+ *         either operand is zero
+ */
+static int32_t cos_angle_q15(const int32_t op1[], const int32_t op2[], int len)
+{
+    int64_t dot = 0;
+    uint64_t norm1 = 0;
+    uint64_t norm2 = 0;
+    for (int i = 0; i < len; i++)
+    {
+        dot += (int64_t)op1[i] * op2[i];
+        norm1 += (uint64_t)((int64_t)op1[i] * op1[i]);
+        norm2 += (uint64_t)((int64_t)op2[i] * op2[i]);
+    }
+    if (norm1 == 0 || norm2 == 0)
+    {
+        return HDC_SIM_UNDEFINED;
+    }
+    uint64_t denominator = norm1 <= UINT64_MAX / norm2
+        ? isqrt(norm1 * norm2) : isqrt(norm1) * isqrt(norm2);
+    uint64_t magnitude = (uint64_t)(dot < 0 ? -dot : dot) * HDC_SIM_ONE
+        / denominator;
+    /* The floored roots can push the quotient just past 1.0 */
+    if (magnitude > HDC_SIM_ONE) magnitude = HDC_SIM_ONE;
+    return dot < 0 ? -(int32_t)magnitude : (int32_t)magnitude;
+}
+
+/**
+ * Generates a random permutation of the integers from 0 to LEN - 1 inclusive.
+ * @param vec    Array to store random permutation in
+ * @param len    Length of the random permutation
+ * @param state  Generator state
+ */
+static void rand_perm(int32_t vec[], int len, uint32_t* state)
+{
+    for (int i = 0; i < len; i++)
+    {
+        vec[i] = i;
+    }
+    for (int i = 0; i < len - 1; i++)
+    {
+        int j = i + (int)(next_random(state) % (uint32_t)(len - i));
+        int32_t swap_temp = vec[i];
+        vec[i] = vec[j];
+        vec[j] = swap_temp;
+    }
+}
+
+/**
+ * Generate a random bipolar vector VEC of length LEN with zero mean.
+ * @param vec      Array to store random hypervector in
+ * @param len      Length of the random hypervector
+ * @param scratch  Scratch array of LEN entries
+ * @param state    Generator state
+ */
+static void gen_random_hv(int8_t vec[], int len, int32_t scratch[],
+                          uint32_t* state)
+{
+    rand_perm(scratch, len, state);
+    for (int i = 0; i < len; i++)
+    {
+        vec[scratch[i]] = i < len / 2 ? 1 : -1;
+    }
+}
+
+/**
+ * Computes the Ngram of N consecutive quantized samples.
+ * @param model   Static model
+ * @param window  N rows of CHANNELS levels
+ * @return 0 on success, -1 if a level is not in the CiM
+ */
+static int compute_ngram(struct hdc_static_model* model, const uint8_t* window)
+{
+    int len = model->D;
+    int32_t* ngram = model->ngram;
+    int32_t* record = model->record;
+    for (int i = 0; i < model->N; i++)
+    {
+        memset(record, 0, len * sizeof(int32_t));
+        for (int ch = 0; ch < model->channels; ch++)
+        {
+            int level = window[i * model->channels + ch];
+            if (level >= model->levels) return -1;
+            const int8_t* cim = model->cim + (size_t)level * len;
+            const int8_t* im = model->im + (size_t)ch * len;
+            for (int d = 0; d < len; d++)
+            {
+                record[d] += cim[d] * im[d];
+            }
+        }
+
+        if (i == 0)
+        {
+            memcpy(ngram, record, len * sizeof(int32_t));
+        }
+        else
+        {
+            int32_t last = ngram[len - 1];
+            memmove(ngram + 1, ngram, (len - 1) * sizeof(int32_t));
+            ngram[0] = last;
+            for (int d = 0; d < len; d++)
+            {
+                ngram[d] *= record[d];
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Calculates how many patterns a class can bundle before its accumulated
+ * vector could overflow. Every ngram entry is bounded by CHANNELS^N, and the
+ * class vectors must keep their entries in int32, their squared norms in
+ * uint64 and their Q15-scaled dot products with an ngram in int64.
+ * @param D         Dimension of hypervectors
+ * @param N         Size of Ngram
+ * @param channels  Number of input channels
+ * @return Maximum number of patterns per class, or 0 if not even one ngram
+ *         fits
+ */
+static int32_t max_patterns(int D, int N, int channels)
+{
+    uint64_t ngram_bound = 1;
+    for (int i = 0; i < N; i++)
+    {
+        ngram_bound *= (uint64_t)channels;
+        if (ngram_bound > INT32_MAX) return 0;
+    }
+
+    uint64_t am_bound = INT32_MAX;
+    uint64_t norm_bound = isqrt(UINT64_MAX / (uint64_t)D);
+    uint64_t dot_bound = ((uint64_t)INT64_MAX / HDC_SIM_ONE) / (uint64_t)D
+        / ngram_bound;
+    if (norm_bound < am_bound) am_bound = norm_bound;
+    if (dot_bound < am_bound) am_bound = dot_bound;
+    return (int32_t)(am_bound / ngram_bound);
+}
+
+/**
+ * Calculates the size of the buffer a static model needs.
+ * @param D         Dimension of hypervectors
+ * @param N         Size of Ngram
+ * @param channels  Number of input channels
+ * @param classes   Number of classes
+ * @param levels    Number of CiM levels (maximum amplitude + 1)
+ * @return Required buffer size in bytes, or 0 if the parameters are invalid
+ *         or an ngram could overflow the int32 class vectors
+ */
+size_t hdc_required_memory(int D, int N, int channels, int classes, int levels)
+{
+    if (D <= 0 || D % 2 != 0 || N <= 0 || channels <= 0 || classes <= 0
+        || levels < 2 || max_patterns(D, N, channels) == 0)
+    {
+        return 0;
+    }
+    return align_size((size_t)levels * D)
+        + align_size((size_t)channels * D)
+        + align_size((size_t)classes * D * sizeof(int32_t))
+        + align_size((size_t)classes * sizeof(int32_t))
+        + 2 * align_size((size_t)D * sizeof(int32_t));
+}
+
+/**
+ * Lays a static model out inside MEMORY and clears its associative memory.
+ * @param model     Model to lay out
+ * @param memory    Buffer of at least hdc_required_memory() bytes, aligned to
+ *                  HDC_STATIC_ALIGN bytes
+ * @param size      Size of MEMORY in bytes
+ * @param D         Dimension of hypervectors
+ * @param N         Size of Ngram
+ * @param channels  Number of input channels
+ * @param classes   Number of classes
+ * @param levels    Number of CiM levels (maximum amplitude + 1)
+ * @return 0 on success, -1 if the parameters are invalid or MEMORY is too
+ *         small or misaligned
+ */
+static int layout_model(struct hdc_static_model* model, void* memory,
+                        size_t size, int D, int N, int channels, int classes,
+                        int levels)
+{
+    size_t required = hdc_required_memory(D, N, channels, classes, levels);
+    if (required == 0 || size < required || !memory) return -1;
+    /* The int32 arrays below would fault on strict-alignment cores */
+    if ((uintptr_t)memory % HDC_STATIC_ALIGN != 0) return -1;
+
+    uint8_t* next = memory;
+    model->D = D;
+    model->N = N;
+    model->channels = channels;
+    model->num_classes = classes;
+    model->levels = levels;
+    model->max_patterns = max_patterns(D, N, channels);
+    model->cim = (int8_t*)next;
+    next += align_size((size_t)levels * D);
+    model->im = (int8_t*)next;
+    next += align_size((size_t)channels * D);
+    model->am = (int32_t*)next;
+    next += align_size((size_t)classes * D * sizeof(int32_t));
+    model->num_pat = (int32_t*)next;
+    next += align_size((size_t)classes * sizeof(int32_t));
+    model->ngram = (int32_t*)next;
+    next += align_size((size_t)D * sizeof(int32_t));
+    model->record = (int32_t*)next;
+
+    memset(model->am, 0, (size_t)classes * D * sizeof(int32_t));
+    memset(model->num_pat, 0, (size_t)classes * sizeof(int32_t));
+    return 0;
+}
+
+/**
+ * Initializes a static model inside MEMORY, including its item memories.
+ * @param model     Model to initialize
+ * @param memory    Buffer of at least hdc_required_memory() bytes, aligned to
+ *                  8 bytes
+ * @param size      Size of MEMORY in bytes
+ * @param D         Dimension of hypervectors
+ * @param N         Size of Ngram
+ * @param channels  Number of input channels
+ * @param classes   Number of classes
+ * @param levels    Number of CiM levels (maximum amplitude + 1)
+ * @return 0 on success, -1 if the parameters are invalid or MEMORY is too
+ *         small or misaligned
+ */
+int hdc_static_init(struct hdc_static_model* model, void* memory, size_t size,
+                    int D, int N, int channels, int classes, int levels)
+{
+    if (layout_model(model, memory, size, D, N, channels, classes, levels))
+    {
+        return -1;
+    }
+
+    uint32_t random_state = 1; /* Seed for predictable output */
+
+    /* Initialize iM with orthogonal hypervectors for the channels */
+    for (int i = 0; i < channels; i++)
+    {
+        gen_random_hv(model->im + (size_t)i * D, D, model->ngram,
+                      &random_state);
+    }
+
+    /* Initialize CiM, flipping D / 2 / (levels - 1) positions per level */
+    int8_t* current_hv = model->cim;
+    int32_t* random_indices = model->record;
+    gen_random_hv(current_hv, D, model->ngram, &random_state);
+    rand_perm(random_indices, D, &random_state);
+    int sp = D / 2 / (levels - 1);
+    for (int i = 1; i < levels; i++)
+    {
+        int8_t* hv = model->cim + (size_t)i * D;
+        memcpy(hv, hv - D, D);
+        for (int j = (i - 1) * sp; j <= i * sp && j < D; j++)
+        {
+            hv[random_indices[j]] *= -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Copies the bipolar rows of a host item memory into an int8 item memory.
+ * @param dest  ROWS x D destination
+ * @param src   ROWS host vectors of D entries
+ * @param rows  Number of vectors
+ * @param D     Dimension of hypervectors
+ * @return 0 on success, -1 if an entry is not +1 or -1
+ */
+static int import_item_memory(int8_t* dest, double** src, int rows, int D)
+{
+    for (int i = 0; i < rows; i++)
+    {
+        for (int d = 0; d < D; d++)
+        {
+            double value = src[i][d];
+            if (value != 1.0 && value != -1.0) return -1;
+            dest[(size_t)i * D + d] = value > 0 ? 1 : -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Loads a model trained with hdctrain into MEMORY, so a host-trained model
+ * can be deployed on the static profile. The item memories and class vectors
+ * are copied, so the static model encodes windows exactly as the host model
+ * does. This is the only function of the profile that reads floating point.
+ * @param model    Model to initialize
+ * @param memory   Buffer of at least hdc_required_memory() bytes, aligned to
+ *                 8 bytes
+ * @param size     Size of MEMORY in bytes
+ * @param trained  Model returned by hdctrain
+ * @param D        Dimension of hypervectors
+ * @param N        Size of Ngram
+ * @return 0 on success, -1 if the model does not fit the static layout,
+ *         MEMORY is too small or misaligned, or a class holds more than
+ *         max_patterns patterns
+ */
+int hdc_static_import(struct hdc_static_model* model, void* memory,
+                      size_t size, const struct hdc_trained_model* trained,
+                      int D, int N)
+{
+    struct hdc_item_memories* memories = trained->item_memories;
+    if (layout_model(model, memory, size, D, N, memories->im_length,
+                     trained->num_classes, memories->cim_length))
+    {
+        return -1;
+    }
+    if (import_item_memory(model->cim, memories->cim, memories->cim_length, D)
+        || import_item_memory(model->im, memories->im, memories->im_length, D))
+    {
+        return -1;
+    }
+
+    for (int label = 0; label < trained->num_classes; label++)
+    {
+        /* Bounds every entry by max_patterns * channels^N */
+        if (trained->num_pat[label] > model->max_patterns) return -1;
+        int32_t* am = model->am + (size_t)label * D;
+        for (int d = 0; d < D; d++)
+        {
+            double value = trained->am[label][d];
+            if (!(value >= -INT32_MAX && value <= INT32_MAX)) return -1;
+            am[d] = (int32_t)value;
+            if (am[d] != value) return -1;
+        }
+        model->num_pat[label] = trained->num_pat[label];
+    }
+    return 0;
+}
+
+/**
+ * Trains a static model on a stream of quantized samples.
+ * @param model              Initialized static model
+ * @param labels             Labels of the samples
+ * @param samples            LEN rows of CHANNELS levels
+ * @param len                Number of samples
+ * @param cutting_angle_q15  Threshold similarity for not including a vector
+ * @return 0 on success, -1 if a sample or label is out of range or a class
+ *         would exceed MODEL->max_patterns patterns
+ */
+int hdc_static_train(struct hdc_static_model* model, const int* labels,
+                     const uint8_t* samples, int len,
+                     int32_t cutting_angle_q15)
+{
+    int N = model->N;
+    int i = 0;
+    while (i < len - N + 1)
+    {
+        int label = labels[i + N - 1];
+        if (label < 0 || label >= model->num_classes) return -1;
+        if (labels[i] == label)
+        {
+            if (compute_ngram(model, samples + (size_t)i * model->channels))
+            {
+                return -1;
+            }
+            int32_t* am = model->am + (size_t)label * model->D;
+            int32_t angle = cos_angle_q15(model->ngram, am, model->D);
+            if (angle < cutting_angle_q15 || angle == HDC_SIM_UNDEFINED)
+            {
+                if (model->num_pat[label] >= model->max_patterns) return -1;
+                for (int d = 0; d < model->D; d++)
+                {
+                    am[d] += model->ngram[d];
+                }
+                model->num_pat[label]++;
+            }
+            i++;
+        }
+        else
+        {
+            i += N - 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Classifies one window of N quantized samples.
+ * @param model           Trained static model
+ * @param window          N rows of CHANNELS levels
+ * @param similarity_q15  If not NULL, receives the Q15 similarity of the
+ *                        predicted class
+ * @return Predicted label, or -1 if a level is out of range or no class has
+ *         been trained
+ */
+int hdc_static_predict(struct hdc_static_model* model, const uint8_t* window,
+                       int32_t* similarity_q15)
+{
+    if (compute_ngram(model, window)) return -1;
+
+    int32_t max_angle = HDC_SIM_UNDEFINED;
+    int predict_label = -1;
+    for (int label = 0; label < model->num_classes; label++)
+    {
+        int32_t angle = cos_angle_q15(model->am + (size_t)label * model->D,
+                                      model->ngram, model->D);
+        if (angle != HDC_SIM_UNDEFINED
+            && (predict_label < 0 || angle > max_angle))
+        {
+            max_angle = angle;
+            predict_label = label;
+        }
+    }
+
+    if (similarity_q15) *similarity_q15 = max_angle;
+    return predict_label;
+}
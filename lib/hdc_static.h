@@ -0,0 +1,58 @@
+#pragma once
+
+#include "hdc.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Static-memory build profile. Nothing in this profile allocates or uses
+ * floating point: the caller provides one buffer of hdc_required_memory()
+ * bytes, input samples are already quantized to CiM levels and similarities
+ * are cosines in Q15 fixed point.
+ *
+ * The profile encodes windows the same way as the pipeline in hdc.h, but
+ * hdc_static_init draws its item memories from its own xorshift generator
+ * rather than rand(), so a model it trains differs from one trained with
+ * hdctrain. To deploy a host-trained model, load it with hdc_static_import
+ * instead, which copies its item memories and class vectors.
+ *
+ * Class vectors are int32. hdc_required_memory rejects configurations in
+ * which a single ngram (bounded by channels^N) could overflow them, and
+ * hdc_static_train fails once a class reaches max_patterns patterns.
+ */
+
+#define HDC_SIM_ONE 32768 /* Q15 cosine similarity of 1.0 */
+#define HDC_SIM_UNDEFINED INT32_MIN /* similarity against a zero vector */
+
+struct hdc_static_model
+{
+    int D;
+    int N;
+    int channels;
+    int num_classes;
+    int levels;
+    int32_t max_patterns; /* patterns per class before the AM could overflow */
+    int8_t* cim;     /* levels x D */
+    int8_t* im;      /* channels x D */
+    int32_t* am;     /* num_classes x D */
+    int32_t* num_pat;
+    int32_t* ngram;  /* scratch */
+    int32_t* record; /* scratch */
+};
+
+size_t hdc_required_memory(int D, int N, int channels, int classes,
+                           int levels);
+
+int hdc_static_init(struct hdc_static_model* model, void* memory, size_t size,
+                    int D, int N, int channels, int classes, int levels);
+
+int hdc_static_import(struct hdc_static_model* model, void* memory,
+                      size_t size, const struct hdc_trained_model* trained,
+                      int D, int N);
+
+int hdc_static_train(struct hdc_static_model* model, const int* labels,
+                     const uint8_t* samples, int len,
+                     int32_t cutting_angle_q15);
+
+int hdc_static_predict(struct hdc_static_model* model, const uint8_t* window,
+                       int32_t* similarity_q15);
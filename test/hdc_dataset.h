@@ -0,0 +1,39 @@
+#pragma once
+
+/*
+ * Deterministic synthetic EMG data shared by the integration test and the
+ * benchmarks. The noise comes from its own LCG rather than rand(), which the
+ * library reseeds when it builds item memories, so the data is the same on
+ * every platform.
+ */
+
+#define HDC_DATASET_CHANNELS 4
+
+/**
+ * Generates a synthetic EMG data set in which every class has its own mean
+ * amplitude per channel, with labels changing in runs of 100 samples.
+ * @param labels       Array to store LEN labels in
+ * @param samples      LEN rows of HDC_DATASET_CHANNELS samples
+ * @param len          Number of samples
+ * @param num_classes  Number of classes
+ * @param maxl         Maximum amplitude of EMG signal
+ * @param seed         Seed of the noise
+ * @param noise        Noise amplitude in levels
+ */
+static void hdc_gen_dataset(int labels[], double** samples, int len,
+                            int num_classes, int maxl, unsigned int seed,
+                            int noise)
+{
+    for (int i = 0; i < len; i++)
+    {
+        int label = (i / 100) % num_classes;
+        labels[i] = label;
+        for (int ch = 0; ch < HDC_DATASET_CHANNELS; ch++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            int mean = ((label + 1) * (ch + 2) * 3) % (maxl - 2) + 1;
+            samples[i][ch] =
+                mean + (int)((seed >> 16) % (2 * noise + 1)) - noise;
+        }
+    }
+}
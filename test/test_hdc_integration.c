@@ -0,0 +1,778 @@
+#define _GNU_SOURCE
+#define UNITY_INCLUDE_CONFIG_H
+#include <stdlib.h>
+
+/* Counts every allocation made by the library while a configuration runs */
+static long alloc_calls;
+
+static void* counted_malloc(size_t size)
+{
+    alloc_calls++;
+    return malloc(size);
+}
+
+static void* counted_calloc(size_t num, size_t size)
+{
+    alloc_calls++;
+    return calloc(num, size);
+}
+
+#define malloc(size) counted_malloc(size)
+#define calloc(num, size) counted_calloc(num, size)
+#include "../lib/hdc.c" /* needed to count allocations and label windows */
+#undef malloc
+#undef calloc
+
+#include "hdc_dataset.h"
+#include "unity.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define CHANNELS HDC_DATASET_CHANNELS
+#define MAXL 21
+#define CLASSES 5
+#define TRAIN_SAMPLES 2000
+#define TEST_SAMPLES 2000
+#define REPEATS 3
+#define CALIBRATION_LEN 10000
+#define CALIBRATION_PASSES 20000
+#define MAX_BASELINE_ENTRIES 128
+
+/*
+ * Regression gate for the end-to-end pipelines. Every configuration is
+ * trained and tested on the same deterministic synthetic data set, and its
+ * accuracy, predicted labels, throughput, retired instructions and
+ * allocation count are compared against the baseline file given as the
+ * first argument. Run with HDC_REGRESSION_RECORD=1 to rewrite the baseline
+ * from the current build instead. Budgets are read from the baseline file
+ * and can be overridden with HDC_BUDGET_<NAME> environment variables.
+ *
+ * Accuracy and predicted labels have no budget: any change in predictions
+ * also changes the label hash, so it needs a new baseline. Instruction
+ * counts are only written on hosts with hardware counters, and recording on
+ * a host without them keeps the counts already in the baseline.
+ *
+ * Throughput is compared relative to a calibration loop timed in the same
+ * process, so baselines carry across hosts. Throughput, instructions and
+ * allocations depend on the build flags recorded in the baseline and are
+ * skipped when they differ from this build; set
+ * HDC_REGRESSION_REQUIRE_COUNTERS to fail instead of skipping the
+ * instruction budget when it cannot be checked.
+ */
+
+/* Build flags the performance keys of a baseline depend on */
+static const struct
+{
+    const char* key;
+    int value;
+} build_flags[] = {
+#ifdef HDC_SPECIALIZED_KERNELS
+    { "build.specialized_kernels", 1 },
+#else
+    { "build.specialized_kernels", 0 },
+#endif
+#ifdef HDC_WIDE_LEVELS
+    { "build.wide_levels", 1 },
+#else
+    { "build.wide_levels", 0 },
+#endif
+};
+
+#define NUM_BUILD_FLAGS ((int)(sizeof(build_flags) / sizeof(build_flags[0])))
+
+enum regression_kind
+{
+    REGRESSION_DENSE,
+    REGRESSION_COMPRESSED,
+    REGRESSION_INDEXED,
+    REGRESSION_SPARSE
+};
+
+struct regression_config
+{
+    const char* name;
+    enum regression_kind kind;
+    int D;
+    int N;
+    int bits;
+    double keep_fraction;
+    int num_lists;
+    int nprobe;
+    int blocks;
+    int block_size;
+};
+
+static const struct regression_config configs[] = {
+    { .name = "dense", .kind = REGRESSION_DENSE, .D = 10000, .N = 4 },
+    { .name = "dense_generic", .kind = REGRESSION_DENSE, .D = 2000, .N = 3 },
+    { .name = "compressed", .kind = REGRESSION_COMPRESSED, .D = 10000,
+      .N = 4, .bits = 1, .keep_fraction = 1.0 },
+    { .name = "pruned", .kind = REGRESSION_COMPRESSED, .D = 10000, .N = 4,
+      .bits = 3, .keep_fraction = 0.25 },
+    { .name = "indexed", .kind = REGRESSION_INDEXED, .D = 10000, .N = 4,
+      .bits = 1, .keep_fraction = 1.0, .num_lists = 2, .nprobe = 1 },
+    { .name = "sparse", .kind = REGRESSION_SPARSE, .N = 4, .blocks = 100,
+      .block_size = 100 },
+};
+
+#define NUM_CONFIGS ((int)(sizeof(configs) / sizeof(configs[0])))
+
+/* Models built for one configuration; unused members stay NULL */
+struct regression_model
+{
+    struct hdc_trained_model* dense;
+    struct hdc_compressed_model* compressed;
+    struct hdc_am_index* index;
+    struct hdc_sparse_model* sparse;
+};
+
+struct regression_result
+{
+    double accuracy;
+    unsigned long labels;
+    double windows_per_sec;
+    double instructions_per_window; /* negative without hardware counters */
+    long allocations;
+};
+
+struct baseline_entry
+{
+    char key[64];
+    double value;
+};
+
+static const char* baseline_path;
+static struct baseline_entry baseline[MAX_BASELINE_ENTRIES];
+static int baseline_len;
+static struct regression_result results[NUM_CONFIGS];
+static double calibration; /* multiply-adds per second of this host */
+static int same_build; /* whether the baseline was recorded with these flags */
+
+static int train_labels[TRAIN_SAMPLES];
+static double* train_set[TRAIN_SAMPLES];
+static int test_labels[TEST_SAMPLES];
+static double* test_set[TEST_SAMPLES];
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+/**
+ * Returns the current monotonic time in seconds.
+ */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Opens a counter of the user-space instructions retired by this thread.
+ * @return File descriptor of the counter, or -1 if hardware counters are not
+ *         available
+ */
+static int open_instruction_counter(void)
+{
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+static void start_counter(int fd)
+{
+#ifdef __linux__
+    if (fd < 0) return;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+}
+
+/**
+ * Stops a counter opened by open_instruction_counter.
+ * @param fd  File descriptor of the counter
+ * @return Instructions retired since start_counter, or -1 on failure
+ */
+static double stop_counter(int fd)
+{
+#ifdef __linux__
+    uint64_t count;
+    if (fd < 0) return -1;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) return -1;
+    return (double)count;
+#else
+    return -1;
+#endif
+}
+
+static int build_model(const struct regression_config* config,
+                       struct regression_model* model)
+{
+    memset(model, 0, sizeof(*model));
+    if (config->kind == REGRESSION_SPARSE)
+    {
+        model->sparse = hdctrain_sparse(train_labels, train_set,
+                                        TRAIN_SAMPLES, CLASSES, config->blocks,
+                                        config->block_size, config->N, MAXL,
+                                        1.0, 0.9);
+        return model->sparse ? 0 : -1;
+    }
+
+    model->dense = hdctrain(train_labels, train_set, TRAIN_SAMPLES, CLASSES,
+                            config->D, config->N, MAXL, 1.0, 0.9);
+    if (!model->dense) return -1;
+    if (config->kind == REGRESSION_DENSE) return 0;
+    model->compressed = hdccompress(model->dense, config->D, config->bits,
+                                    config->keep_fraction);
+    if (!model->compressed) return -1;
+    if (config->kind == REGRESSION_COMPRESSED) return 0;
+    model->index = hdcindex(model->compressed, config->num_lists, 10);
+    return model->index ? 0 : -1;
+}
+
+/**
+ * Tests a built model through the core of its public predict function.
+ * @param config     Configuration the model was built for
+ * @param model      Built model
+ * @param predicted  If not NULL, receives the label predicted for each window
+ * @return Accuracy of the model
+ */
+static struct hdc_accuracy predict_model(const struct regression_config* config,
+                                         struct regression_model* model,
+                                         int predicted[])
+{
+    switch (config->kind)
+    {
+    case REGRESSION_DENSE:
+        return predict_dense(model->dense, test_labels, test_set, TEST_SAMPLES,
+                             config->D, config->N, 1.0, predicted);
+    case REGRESSION_COMPRESSED:
+        return predict_packed(model->compressed, NULL, 0, test_labels,
+                              test_set, TEST_SAMPLES, config->N, 1.0,
+                              predicted);
+    case REGRESSION_INDEXED:
+        return predict_packed(model->index->model, model->index,
+                              config->nprobe, test_labels, test_set,
+                              TEST_SAMPLES, config->N, 1.0, predicted);
+    default:
+        return predict_sparse(model->sparse, test_labels, test_set,
+                              TEST_SAMPLES, config->N, 1.0, predicted);
+    }
+}
+
+static void destroy_model(struct regression_model* model)
+{
+    if (model->index) hdcdeinit_index(model->index);
+    if (model->compressed) hdcdeinit_compressed(model->compressed);
+    if (model->dense) hdcdeinit(model->dense);
+    if (model->sparse) hdcdeinit_sparse(model->sparse);
+}
+
+/**
+ * Hashes predicted labels with FNV-1a.
+ * @param predicted  Predicted labels, -1 for unclassified windows
+ * @param len        Number of labels
+ * @return 32-bit hash of the labels
+ */
+static unsigned long hash_labels(const int predicted[], int len)
+{
+    unsigned long hash = 2166136261ul;
+    for (int i = 0; i < len; i++)
+    {
+        hash = ((hash ^ (unsigned long)(predicted[i] + 1)) * 16777619ul)
+            & 0xfffffffful;
+    }
+    return hash;
+}
+
+/**
+ * Times a fixed multiply-add loop that does not touch the library, giving a
+ * measure of this host's speed to normalize throughput by.
+ * @return Best multiply-adds per second over REPEATS runs
+ */
+static double calibrate(void)
+{
+    static double acc[CALIBRATION_LEN];
+    double best_time = -1;
+    for (int r = 0; r < REPEATS; r++)
+    {
+        for (int d = 0; d < CALIBRATION_LEN; d++)
+        {
+            acc[d] = d;
+        }
+        double start = now();
+        for (int p = 0; p < CALIBRATION_PASSES; p++)
+        {
+            for (int d = 0; d < CALIBRATION_LEN; d++)
+            {
+                acc[d] = acc[d] * 0.5 + p;
+            }
+        }
+        double elapsed = now() - start;
+        double sum = 0;
+        for (int d = 0; d < CALIBRATION_LEN; d++)
+        {
+            sum += acc[d];
+        }
+        if (sum == 0.0) printf("\n"); /* keep the loop from being elided */
+        if (best_time < 0 || elapsed < best_time) best_time = elapsed;
+    }
+    return (double)CALIBRATION_LEN * CALIBRATION_PASSES / best_time;
+}
+
+/**
+ * Builds, tests and measures one configuration.
+ * @param config  Configuration to run
+ * @param result  Receives the measurements
+ */
+static void measure(const struct regression_config* config,
+                    struct regression_result* result)
+{
+    struct regression_model model;
+    int windows = TEST_SAMPLES - config->N + 1;
+    int* predicted = malloc(windows * sizeof(int));
+    TEST_ASSERT_NOT_NULL(predicted);
+
+    alloc_calls = 0;
+    TEST_ASSERT_EQUAL_INT(0, build_model(config, &model));
+    struct hdc_accuracy accuracy = predict_model(config, &model, predicted);
+    result->allocations = alloc_calls;
+    result->accuracy = accuracy.accuracy;
+    result->labels = hash_labels(predicted, windows);
+    free(predicted);
+    TEST_ASSERT_EQUAL_INT(windows, accuracy.num_tests);
+
+    int counter = open_instruction_counter();
+    double best_time = -1;
+    double best_instructions = -1;
+    for (int r = 0; r < REPEATS; r++)
+    {
+        double start = now();
+        start_counter(counter);
+        predict_model(config, &model, NULL);
+        double instructions = stop_counter(counter);
+        double elapsed = now() - start;
+        if (best_time < 0 || elapsed < best_time) best_time = elapsed;
+        if (instructions >= 0
+            && (best_instructions < 0 || instructions < best_instructions))
+        {
+            best_instructions = instructions;
+        }
+    }
+#ifdef __linux__
+    if (counter >= 0) close(counter);
+#endif
+    result->windows_per_sec = windows / best_time;
+    result->instructions_per_window =
+        best_instructions >= 0 ? best_instructions / windows : -1;
+
+    destroy_model(&model);
+}
+
+/**
+ * Loads the baseline file into BASELINE. Blank lines and lines starting with
+ * '#' are ignored; every other line is a key followed by a value.
+ * @param path  Path of the baseline file
+ * @return 0 on success, -1 if the file cannot be read
+ */
+static int load_baseline(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (!file) return -1;
+    char line[256];
+    baseline_len = 0;
+    while (fgets(line, sizeof(line), file) && baseline_len < MAX_BASELINE_ENTRIES)
+    {
+        struct baseline_entry* entry = &baseline[baseline_len];
+        if (line[0] == '#') continue;
+        if (sscanf(line, "%63s %lf", entry->key, &entry->value) == 2)
+        {
+            baseline_len++;
+        }
+    }
+    fclose(file);
+    return 0;
+}
+
+/**
+ * Looks up KEY in the baseline.
+ * @param key    Key to look up
+ * @param value  Receives the value of KEY
+ * @return 1 if KEY is in the baseline, 0 otherwise
+ */
+static int baseline_value(const char* key, double* value)
+{
+    for (int i = 0; i < baseline_len; i++)
+    {
+        if (strcmp(baseline[i].key, key) == 0)
+        {
+            *value = baseline[i].value;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Returns the budget NAME from the HDC_BUDGET_<NAME> environment variable,
+ * the baseline file, or DEFAULT_VALUE, in that order.
+ */
+static double budget(const char* name, double default_value)
+{
+    char key[64];
+    double value;
+    snprintf(key, sizeof(key), "HDC_BUDGET_%s", name);
+    for (char* c = key; *c; c++)
+    {
+        if (*c >= 'a' && *c <= 'z') *c -= 'a' - 'A';
+    }
+    const char* env = getenv(key);
+    if (env) return atof(env);
+    snprintf(key, sizeof(key), "budget.%s", name);
+    return baseline_value(key, &value) ? value : default_value;
+}
+
+/**
+ * Compares the build flags recorded in the baseline with this build and
+ * reports every difference. Baselines without build keys match any build.
+ * @return 1 if the flags match, 0 otherwise
+ */
+static int check_build_flags(void)
+{
+    int match = 1;
+    double value;
+    for (int i = 0; i < NUM_BUILD_FLAGS; i++)
+    {
+        if (baseline_value(build_flags[i].key, &value)
+            && (int)value != build_flags[i].value)
+        {
+            printf("baseline has %s %d but this build has %d\n",
+                   build_flags[i].key, (int)value, build_flags[i].value);
+            match = 0;
+        }
+    }
+    return match;
+}
+
+/**
+ * Checks the instruction count of a configuration against the baseline,
+ * reporting why when it cannot be checked.
+ * @param config    Configuration that was run
+ * @param result    Its measurements
+ * @param message   Message to append a violation to
+ * @param size      Size of MESSAGE
+ * @return Number of characters appended to MESSAGE
+ */
+static size_t check_instructions(const struct regression_config* config,
+                                 struct regression_result* result,
+                                 char* message, size_t size)
+{
+    char key[64];
+    double expected;
+    const char* skip_reason = NULL;
+
+    snprintf(key, sizeof(key), "%s.instructions_per_window", config->name);
+    if (!baseline_value(key, &expected) || expected <= 0)
+    {
+        skip_reason = "the baseline has no instruction count, record it on a "
+            "host with hardware counters";
+    }
+    else if (result->instructions_per_window < 0)
+    {
+        skip_reason = "hardware counters unavailable";
+    }
+    else if (result->instructions_per_window
+             > expected * (1.0 + budget("instructions", 0.1)))
+    {
+        return snprintf(message, size, " %.0f instructions/window > %.0f;",
+                        result->instructions_per_window, expected);
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (getenv("HDC_REGRESSION_REQUIRE_COUNTERS"))
+    {
+        return snprintf(message, size, " instructions unchecked, %s;",
+                        skip_reason);
+    }
+    printf("%s: instruction budget skipped, %s\n", config->name, skip_reason);
+    return 0;
+}
+
+/**
+ * Checks the result of a configuration against the baseline, failing the
+ * current test with every violated budget.
+ * @param config  Configuration that was run
+ * @param result  Its measurements
+ */
+static void check_result(const struct regression_config* config,
+                         struct regression_result* result)
+{
+    char message[1024] = "";
+    char key[64];
+    double expected;
+    size_t used = 0;
+
+    printf("%s: accuracy %.6f, labels %08lx, %.0f windows/s, "
+           "%.0f instructions/window, %ld allocations\n", config->name,
+           result->accuracy, result->labels, result->windows_per_sec,
+           result->instructions_per_window, result->allocations);
+    if (getenv("HDC_REGRESSION_RECORD")) return;
+
+    snprintf(key, sizeof(key), "%s.accuracy", config->name);
+    if (!baseline_value(key, &expected))
+    {
+        snprintf(message, sizeof(message), "%s has no baseline, record one "
+                 "with HDC_REGRESSION_RECORD=1", config->name);
+        TEST_FAIL_MESSAGE(message);
+    }
+    if (fabs(result->accuracy - expected) > 1e-6) /* printed precision */
+    {
+        used += snprintf(message + used, sizeof(message) - used,
+                         " accuracy %.6f != %.6f;", result->accuracy,
+                         expected);
+    }
+
+    snprintf(key, sizeof(key), "%s.labels", config->name);
+    if (baseline_value(key, &expected)
+        && result->labels != (unsigned long)expected)
+    {
+        used += snprintf(message + used, sizeof(message) - used,
+                         " labels %08lx != %08lx;", result->labels,
+                         (unsigned long)expected);
+    }
+
+    if (!same_build)
+    {
+        if (used > 0) TEST_FAIL_MESSAGE(message);
+        return;
+    }
+
+    /* Scale the recorded throughput by how fast this host runs calibrate() */
+    double base_calibration;
+    snprintf(key, sizeof(key), "%s.windows_per_sec", config->name);
+    if (baseline_value(key, &expected)
+        && baseline_value("calibration.ops_per_sec", &base_calibration)
+        && base_calibration > 0)
+    {
+        expected *= calibration / base_calibration;
+        if (result->windows_per_sec
+            < expected * (1.0 - budget("throughput", 0.5)))
+        {
+            used += snprintf(message + used, sizeof(message) - used,
+                             " %.0f windows/s < calibrated %.0f;",
+                             result->windows_per_sec, expected);
+        }
+    }
+
+    used += check_instructions(config, result, message + used,
+                               sizeof(message) - used);
+
+    snprintf(key, sizeof(key), "%s.allocations", config->name);
+    if (baseline_value(key, &expected)
+        && result->allocations
+           > expected * (1.0 + budget("allocations", 0.0)))
+    {
+        used += snprintf(message + used, sizeof(message) - used,
+                         " %ld allocations > %.0f;", result->allocations,
+                         expected);
+    }
+
+    if (used > 0) TEST_FAIL_MESSAGE(message);
+}
+
+/**
+ * Rewrites the baseline file with the current results, keeping its budgets.
+ * Without hardware counters, the instruction counts of the old baseline are
+ * kept if it was recorded with the same build flags.
+ * @param path  Path of the baseline file
+ * @return 0 on success, -1 if the file cannot be written
+ */
+static int record_baseline(const char* path)
+{
+    static const char* budget_names[] = { "throughput", "instructions",
+                                          "allocations" };
+    static const double budget_defaults[] = { 0.5, 0.1, 0.0 };
+    double budgets[3];
+    double instructions[NUM_CONFIGS];
+    int keep_instructions = check_build_flags();
+    for (int i = 0; i < 3; i++)
+    {
+        budgets[i] = budget(budget_names[i], budget_defaults[i]);
+    }
+    for (int c = 0; c < NUM_CONFIGS; c++)
+    {
+        char key[64];
+        snprintf(key, sizeof(key), "%s.instructions_per_window",
+                 configs[c].name);
+        instructions[c] = results[c].instructions_per_window;
+        if (instructions[c] < 0
+            && !(keep_instructions && baseline_value(key, &instructions[c])))
+        {
+            instructions[c] = -1;
+        }
+    }
+
+    FILE* file = fopen(path, "w");
+    if (!file) return -1;
+    fprintf(file, "# Baseline of test_hdc_integration, rewritten by running it "
+            "with HDC_REGRESSION_RECORD=1.\n"
+            "# Budgets are relative to the recorded value; accuracy and labels "
+            "must match\n# exactly. windows_per_sec is scaled by this host's "
+            "calibration against\n# calibration.ops_per_sec. "
+            "instructions_per_window is only present when it\n# was recorded "
+            "on a host with hardware counters.\n");
+    for (int i = 0; i < NUM_BUILD_FLAGS; i++)
+    {
+        fprintf(file, "%s %d\n", build_flags[i].key, build_flags[i].value);
+    }
+    fprintf(file, "calibration.ops_per_sec %.0f\n", calibration);
+    for (int i = 0; i < 3; i++)
+    {
+        fprintf(file, "budget.%s %g\n", budget_names[i], budgets[i]);
+    }
+    for (int c = 0; c < NUM_CONFIGS; c++)
+    {
+        const char* name = configs[c].name;
+        fprintf(file, "\n%s.accuracy %.6f\n", name, results[c].accuracy);
+        fprintf(file, "%s.labels %lu\n", name, results[c].labels);
+        fprintf(file, "%s.windows_per_sec %.0f\n", name,
+                results[c].windows_per_sec);
+        if (instructions[c] > 0)
+        {
+            fprintf(file, "%s.instructions_per_window %.0f\n", name,
+                    instructions[c]);
+        }
+        fprintf(file, "%s.allocations %ld\n", name, results[c].allocations);
+    }
+    fclose(file);
+    return 0;
+}
+
+static void run_config(int c)
+{
+    measure(&configs[c], &results[c]);
+    check_result(&configs[c], &results[c]);
+}
+
+void test_hdc_regression_dense()
+{
+    run_config(0);
+}
+
+void test_hdc_regression_dense_generic()
+{
+    run_config(1);
+}
+
+void test_hdc_regression_compressed()
+{
+    run_config(2);
+}
+
+void test_hdc_regression_pruned()
+{
+    run_config(3);
+}
+
+void test_hdc_regression_indexed()
+{
+    run_config(4);
+}
+
+void test_hdc_regression_sparse()
+{
+    run_config(5);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s BASELINE\n", argv[0]);
+        return 1;
+    }
+    baseline_path = argv[1];
+    /* Recording reads the old baseline too, to keep its budgets and counts */
+    if (load_baseline(baseline_path) && !getenv("HDC_REGRESSION_RECORD"))
+    {
+        fprintf(stderr, "test_hdc_integration: cannot read %s\n",
+                baseline_path);
+        return 1;
+    }
+    same_build = getenv("HDC_REGRESSION_RECORD") || check_build_flags();
+    if (!same_build)
+    {
+        printf("throughput, instruction and allocation budgets skipped, "
+               "record a baseline for this build to check them\n");
+    }
+    calibration = calibrate();
+    printf("calibration: %.0f multiply-adds/s\n", calibration);
+
+    for (int i = 0; i < TRAIN_SAMPLES; i++)
+    {
+        train_set[i] = malloc(CHANNELS * sizeof(double));
+    }
+    for (int i = 0; i < TEST_SAMPLES; i++)
+    {
+        test_set[i] = malloc(CHANNELS * sizeof(double));
+    }
+    hdc_gen_dataset(train_labels, train_set, TRAIN_SAMPLES, CLASSES, MAXL, 12345,
+                    1);
+    hdc_gen_dataset(test_labels, test_set, TEST_SAMPLES, CLASSES, MAXL, 54321, 4);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_hdc_regression_dense);
+    RUN_TEST(test_hdc_regression_dense_generic);
+    RUN_TEST(test_hdc_regression_compressed);
+    RUN_TEST(test_hdc_regression_pruned);
+    RUN_TEST(test_hdc_regression_indexed);
+    RUN_TEST(test_hdc_regression_sparse);
+    int failures = UNITY_END();
+
+    if (getenv("HDC_REGRESSION_RECORD"))
+    {
+        if (failures == 0 && record_baseline(baseline_path) == 0)
+        {
+            printf("recorded %s\n", baseline_path);
+        }
+        else
+        {
+            failures++;
+        }
+    }
+
+    for (int i = 0; i < TRAIN_SAMPLES; i++)
+    {
+        free(train_set[i]);
+    }
+    for (int i = 0; i < TEST_SAMPLES; i++)
+    {
+        free(test_set[i]);
+    }
+    return failures;
+}
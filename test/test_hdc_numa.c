@@ -0,0 +1,101 @@
+#define UNITY_INCLUDE_CONFIG_H
+#include "../lib/hdc_numa.c" /* needed to unit test static functions */
+#include "unity.h"
+
+#define D 1000
+#define N 3
+#define CLASSES 3
+#define MAXL 20
+#define SAMPLES 300
+
+static int labels[SAMPLES];
+static double sample_data[SAMPLES][4];
+static double* samples[SAMPLES];
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_hdc_numa_parse_cpulist()
+{
+    int cpus[8];
+    int expected[] = { 0, 1, 2, 3, 8, 10, 11 };
+    TEST_ASSERT_EQUAL_INT(7, parse_cpulist("0-3,8,10-11\n", cpus, 8));
+    TEST_ASSERT_EQUAL_INT_ARRAY(expected, cpus, 7);
+    TEST_ASSERT_EQUAL_INT(2, parse_cpulist("4-9", cpus, 2));
+    TEST_ASSERT_EQUAL_INT(0, parse_cpulist("\n", cpus, 8));
+}
+
+void test_hdc_numa_filter_allowed()
+{
+    int cpus[] = { 0, 1, 2, 3, CPU_SETSIZE };
+    int expected[] = { 1, 3 };
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    CPU_SET(1, &allowed);
+    CPU_SET(3, &allowed);
+    TEST_ASSERT_EQUAL_INT(2, filter_allowed(cpus, 5, &allowed));
+    TEST_ASSERT_EQUAL_INT_ARRAY(expected, cpus, 2);
+}
+
+void test_hdc_numa_topology()
+{
+    struct hdc_numa_pool pool;
+    cpu_set_t allowed;
+    TEST_ASSERT_EQUAL_INT(0, read_topology(&pool));
+    TEST_ASSERT_TRUE(pool.num_nodes >= 1);
+    TEST_ASSERT_TRUE(pool.cpu_offsets[pool.num_nodes] >= pool.num_nodes);
+    TEST_ASSERT_EQUAL_INT(0, sched_getaffinity(0, sizeof(allowed), &allowed));
+    for (int i = 0; i < pool.cpu_offsets[pool.num_nodes]; i++)
+    {
+        TEST_ASSERT_TRUE(CPU_ISSET(pool.cpus[i], &allowed));
+    }
+    free(pool.cpus);
+    free(pool.cpu_offsets);
+    free(pool.node_ids);
+}
+
+void test_hdc_numa_predict_matches_hdcpredict()
+{
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        labels[i] = (i / 30) % CLASSES;
+        for (int ch = 0; ch < 4; ch++)
+        {
+            sample_data[i][ch] = (labels[i] * 6 + ch * 3 + i % 3) % MAXL;
+        }
+        samples[i] = sample_data[i];
+    }
+    struct hdc_trained_model* model =
+        hdctrain(labels, samples, SAMPLES, CLASSES, D, N, MAXL, 1.0, 0.9);
+    struct hdc_accuracy expected =
+        hdcpredict(model, labels, samples, SAMPLES, D, N, 1.0);
+    struct hdc_numa_pool* pool = hdc_numa_pool_create(model, D);
+    hdcdeinit(model);
+
+    for (int remote = 0; remote <= 1; remote++)
+    {
+        struct hdc_accuracy actual =
+            numa_predict(pool, labels, samples, SAMPLES, N, 1.0, 0, 16,
+                         remote);
+        TEST_ASSERT_EQUAL_INT(expected.num_tests, actual.num_tests);
+        TEST_ASSERT_EQUAL_INT(expected.correct, actual.correct);
+        TEST_ASSERT_EQUAL_INT(expected.tranz_error, actual.tranz_error);
+        TEST_ASSERT_EQUAL_FLOAT(expected.accuracy, actual.accuracy);
+    }
+    hdc_numa_pool_destroy(pool);
+}
+
+int main(int argc, char* argv[])
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_hdc_numa_parse_cpulist);
+    RUN_TEST(test_hdc_numa_filter_allowed);
+    RUN_TEST(test_hdc_numa_topology);
+    RUN_TEST(test_hdc_numa_predict_matches_hdcpredict);
+    return UNITY_END();
+}
@@ -0,0 +1,168 @@
+#define UNITY_INCLUDE_CONFIG_H
+#include "hdc_static.h"
+#include "unity.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define D 1000
+#define N 4
+#define CHANNELS 4
+#define CLASSES 3
+#define LEVELS 22
+#define SAMPLES 600
+
+/* Allocator that fails on any call, so the test fails if anything allocates */
+static int alloc_calls;
+
+void* malloc(size_t size)
+{
+    alloc_calls++;
+    return NULL;
+}
+
+void* calloc(size_t num, size_t size)
+{
+    alloc_calls++;
+    return NULL;
+}
+
+void* realloc(void* ptr, size_t size)
+{
+    alloc_calls++;
+    return NULL;
+}
+
+void free(void* ptr)
+{
+    if (ptr) alloc_calls++;
+}
+
+static uint64_t arena[40000];
+static struct hdc_static_model model;
+static int labels[SAMPLES];
+static uint8_t samples[SAMPLES * CHANNELS];
+
+/**
+ * Generates quantized samples in which every class has its own level per
+ * channel, with labels changing in runs of 50 samples.
+ */
+static void gen_dataset(void)
+{
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        int label = (i / 50) % CLASSES;
+        labels[i] = label;
+        for (int ch = 0; ch < CHANNELS; ch++)
+        {
+            samples[i * CHANNELS + ch] =
+                (uint8_t)((label * 7 + ch * 5 + i % 2) % LEVELS);
+        }
+    }
+}
+
+void setUp()
+{
+    alloc_calls = 0;
+}
+
+void tearDown()
+{
+    TEST_ASSERT_EQUAL_INT(0, alloc_calls);
+}
+
+void test_hdc_static_required_memory()
+{
+    TEST_ASSERT_EQUAL_INT(0, hdc_required_memory(999, N, CHANNELS, CLASSES,
+                                                 LEVELS));
+    TEST_ASSERT_EQUAL_INT(0, hdc_required_memory(D, 0, CHANNELS, CLASSES,
+                                                 LEVELS));
+    /* 8^8 fits in int32, but a few patterns of it would overflow the AM */
+    TEST_ASSERT_EQUAL_INT(0, hdc_required_memory(D, 8, 8, CLASSES, LEVELS));
+    TEST_ASSERT_TRUE(hdc_required_memory(D, N, CHANNELS, CLASSES, LEVELS)
+                     <= sizeof(arena));
+}
+
+void test_hdc_static_init_too_small()
+{
+    size_t size = hdc_required_memory(D, N, CHANNELS, CLASSES, LEVELS);
+    TEST_ASSERT_EQUAL_INT(-1, hdc_static_init(&model, arena, size - 1, D, N,
+                                              CHANNELS, CLASSES, LEVELS));
+}
+
+void test_hdc_static_init_misaligned()
+{
+    TEST_ASSERT_EQUAL_INT(-1, hdc_static_init(&model, (char*)arena + 4,
+                                              sizeof(arena) - 4, D, N,
+                                              CHANNELS, CLASSES, LEVELS));
+}
+
+void test_hdc_static_item_memories()
+{
+    TEST_ASSERT_EQUAL_INT(0, hdc_static_init(&model, arena, sizeof(arena), D,
+                                             N, CHANNELS, CLASSES, LEVELS));
+    int sum = 0;
+    int first_last = 0;
+    for (int d = 0; d < D; d++)
+    {
+        sum += model.im[d];
+        first_last += model.cim[d] * model.cim[(LEVELS - 1) * D + d];
+    }
+    TEST_ASSERT_EQUAL_INT(0, sum);
+    /* The lowest and highest levels should be close to orthogonal */
+    TEST_ASSERT_TRUE(first_last < D / 10 && first_last > -D / 10);
+}
+
+void test_hdc_static_train_predict()
+{
+    TEST_ASSERT_EQUAL_INT(0, hdc_static_init(&model, arena, sizeof(arena), D,
+                                             N, CHANNELS, CLASSES, LEVELS));
+    TEST_ASSERT_EQUAL_INT(0, hdc_static_train(&model, labels, samples,
+                                              SAMPLES, HDC_SIM_ONE * 9 / 10));
+    int correct = 0;
+    int num_tests = 0;
+    for (int i = 0; i < SAMPLES - N + 1; i++)
+    {
+        if (labels[i] != labels[i + N - 1]) continue;
+        int32_t similarity;
+        int label = hdc_static_predict(&model, samples + i * CHANNELS,
+                                       &similarity);
+        TEST_ASSERT_TRUE(similarity <= HDC_SIM_ONE);
+        num_tests++;
+        if (label == labels[i]) correct++;
+    }
+    TEST_ASSERT_EQUAL_INT(num_tests, correct);
+}
+
+void test_hdc_static_self_similarity()
+{
+    int window_labels[N] = { 0 };
+    TEST_ASSERT_EQUAL_INT(0, hdc_static_init(&model, arena, sizeof(arena), D,
+                                             N, CHANNELS, CLASSES, LEVELS));
+    TEST_ASSERT_EQUAL_INT(0, hdc_static_train(&model, window_labels, samples,
+                                              N, HDC_SIM_ONE));
+    int32_t similarity;
+    TEST_ASSERT_EQUAL_INT(0, hdc_static_predict(&model, samples, &similarity));
+    TEST_ASSERT_EQUAL_INT(HDC_SIM_ONE, similarity);
+}
+
+void test_hdc_static_level_out_of_range()
+{
+    uint8_t window[N * CHANNELS] = { 0 };
+    window[5] = LEVELS;
+    TEST_ASSERT_EQUAL_INT(-1, hdc_static_predict(&model, window, NULL));
+}
+
+int main(int argc, char* argv[])
+{
+    setvbuf(stdout, NULL, _IONBF, 0); /* stdio must not allocate either */
+    gen_dataset();
+    UNITY_BEGIN();
+    RUN_TEST(test_hdc_static_required_memory);
+    RUN_TEST(test_hdc_static_init_too_small);
+    RUN_TEST(test_hdc_static_init_misaligned);
+    RUN_TEST(test_hdc_static_item_memories);
+    RUN_TEST(test_hdc_static_train_predict);
+    RUN_TEST(test_hdc_static_self_similarity);
+    RUN_TEST(test_hdc_static_level_out_of_range);
+    return UNITY_END();
+}
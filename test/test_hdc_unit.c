@@ -1,6 +1,10 @@
 #define UNITY_INCLUDE_CONFIG_H
 #include "../lib/hdc.c" /* needed to unit test static functions */
+#include "hdc_dataset.h"
 #include "unity.h"
+#ifdef HDC_STATIC_PROFILE
+#include "../lib/hdc_static.h"
+#endif
 
 void setUp()
 {
@@ -64,6 +68,393 @@ void test_hdc_circ_shift()
     TEST_ASSERT_EQUAL_FLOAT_ARRAY(a, b, len);
 }
 
+void test_hdc_quantize_block()
+{
+    double samples[3][4] = { { 0.0, 1.9, 2.5, 10.0 }, { -0.5, -3.0, 4.2, 5.0 },
+                             { 2.0, 4.9, 5.0, 7.5 } };
+    double* buffer[] = { samples[0], samples[1], samples[2] };
+    hdc_level_t expected[] = { 0, 3, 5, 10, 0, 0, 8, 10, 4, 9, 10, 10 };
+    hdc_level_t levels[12];
+    /* -0.5 and -3.0 scale below the CiM, 10.0 and 7.5 above it */
+    TEST_ASSERT_EQUAL_INT(4, quantize_block(levels, buffer, 3, 4, 2.0, 11));
+    TEST_ASSERT_EQUAL_MEMORY(expected, levels, sizeof(levels));
+
+    /* Rows that are not back to back are quantized one at a time */
+    double* reversed[] = { samples[2], samples[1], samples[0] };
+    hdc_level_t expected_reversed[] = { 4, 9, 10, 10, 0, 0, 8, 10,
+                                        0, 3, 5, 10 };
+    TEST_ASSERT_EQUAL_INT(4, quantize_block(levels, reversed, 3, 4, 2.0, 11));
+    TEST_ASSERT_EQUAL_MEMORY(expected_reversed, levels, sizeof(levels));
+}
+
+void test_hdc_select_kernels_fallback()
+{
+    const struct hdc_kernels* kernels = select_kernels(100, 3, 4);
+    TEST_ASSERT_EQUAL_INT(0, kernels->D);
+    TEST_ASSERT_EQUAL_PTR(compute_ngram, kernels->ngram);
+}
+
+void test_hdc_fixed_kernels_match_generic()
+{
+#ifdef HDC_SPECIALIZED_KERNELS
+    int len = 10000;
+    hdc_level_t levels[] = { 0, 3, 7, 20, 1, 4, 9, 18,
+                             2, 6, 11, 16, 5, 8, 13, 14 };
+    struct hdc_item_memories* memories = init_item_memories(len, 20);
+    const struct hdc_kernels* fixed = select_kernels(len, 4, 4);
+    double* expected = malloc(len * sizeof(double));
+    double* actual = malloc(len * sizeof(double));
+    double* record = malloc(len * sizeof(double));
+    TEST_ASSERT_EQUAL_INT(len, fixed->D);
+    TEST_ASSERT_EQUAL_INT(0, compute_ngram(expected, record, levels, memories,
+                                           len, 4));
+    TEST_ASSERT_EQUAL_INT(0, fixed->ngram(actual, record, levels, memories,
+                                          len, 4));
+    TEST_ASSERT_EQUAL_FLOAT_ARRAY(expected, actual, len);
+    TEST_ASSERT_EQUAL_FLOAT(cos_angle(expected, memories->cim[3], len),
+                            fixed->similarity(actual, memories->cim[3], len));
+    free(record);
+    free(actual);
+    free(expected);
+    deinit_item_memories(memories);
+#endif
+}
+
+void test_hdc_search_top_k()
+{
+    double am0[] = { 1.0, 0.0, 0.0, 0.0 };
+    double am1[] = { 1.0, 1.0, 0.0, 0.0 };
+    double am2[] = { 0.0, 0.0, 0.0, 0.0 };
+    double am3[] = { -1.0, 0.0, 0.0, 0.0 };
+    double* am[] = { am0, am1, am2, am3 };
+    double hv[] = { 1.0, 0.0, 0.0, 0.0 };
+    int labels[] = { 0, 1, 3 };
+    struct hdc_trained_model model = { NULL, am, 4, NULL };
+    const struct hdc_kernels* kernels = select_kernels(4, 1, 4);
+    struct hdc_prediction prediction;
+
+    search_top_k(&model, hv, 4, kernels, 1, &prediction);
+    TEST_ASSERT_EQUAL_INT(1, prediction.k);
+    TEST_ASSERT_EQUAL_INT(0, prediction.labels[0]);
+    TEST_ASSERT_EQUAL_FLOAT(1.0 - sqrt(0.5), prediction.margin);
+
+    search_top_k(&model, hv, 4, kernels, 4, &prediction);
+    TEST_ASSERT_EQUAL_INT(3, prediction.k); /* class 2 is untrained */
+    TEST_ASSERT_EQUAL_INT_ARRAY(labels, prediction.labels, 3);
+    TEST_ASSERT_EQUAL_FLOAT(-1.0, prediction.similarities[2]);
+}
+
+void test_hdc_classify_reject()
+{
+    int len = 1000;
+    double samples[5][4] = { { 1, 2, 3, 4 }, { 2, 3, 4, 5 }, { 3, 4, 5, 6 },
+                             { 15, 16, 17, 18 }, { 16, 17, 18, 19 } };
+    double* buffer[] = { samples[0], samples[1], samples[2], samples[3],
+                         samples[4] };
+    struct hdc_item_memories* memories = init_item_memories(len, 20);
+    double* am[] = { malloc(len * sizeof(double)),
+                     malloc(len * sizeof(double)) };
+    double* record = malloc(len * sizeof(double));
+    hdc_level_t levels[5 * 4];
+    struct hdc_trained_model model = { memories, am, 2, NULL };
+    struct hdc_prediction prediction;
+    quantize_block(levels, buffer, 5, 4, 1.0, memories->cim_length);
+    compute_ngram(am[0], record, levels, memories, len, 2);
+    compute_ngram(am[1], record, levels + 3 * 4, memories, len, 2);
+    struct hdc_classifier* classifier = hdcclassifier(&model, len, 2);
+
+    TEST_ASSERT_EQUAL_INT(1, hdcclassify(classifier, buffer + 3, 1.0, 2, 0.5,
+                                         &prediction));
+    TEST_ASSERT_EQUAL_INT(2, prediction.k);
+    TEST_ASSERT_EQUAL_FLOAT(1.0, prediction.similarities[0]);
+    TEST_ASSERT_FALSE(prediction.rejected);
+
+    /* Halfway between both classes */
+    TEST_ASSERT_EQUAL_INT(HDC_REJECTED, hdcclassify(classifier, buffer + 2,
+                                                    1.0, 1, 0.5, &prediction));
+    TEST_ASSERT_TRUE(prediction.rejected);
+    TEST_ASSERT_EQUAL_INT(-1, hdcclassify(classifier, buffer, 1.0, 0, 0.5,
+                                          &prediction));
+    hdcdeinit_classifier(classifier);
+    free(record);
+    free(am[1]);
+    free(am[0]);
+    deinit_item_memories(memories);
+}
+
+void test_hdc_popcount64()
+{
+    TEST_ASSERT_EQUAL_INT(0, popcount64(0));
+    TEST_ASSERT_EQUAL_INT(64, popcount64(~(uint64_t)0));
+    TEST_ASSERT_EQUAL_INT(3, popcount64(0x8000000000010001ULL));
+}
+
+void test_hdc_compress_bit_planes()
+{
+    double am0[] = { 4.0, -2.0, 1.0, -4.0 };
+    double* am[] = { am0 };
+    struct hdc_trained_model model = { NULL, am, 1, NULL };
+    struct hdc_compressed_model* compressed = hdccompress(&model, 4, 2, 1.0);
+    double hv[] = { 1.0, 1.0, 1.0, 1.0 };
+    uint64_t query[1];
+    struct hdc_prediction prediction;
+    TEST_ASSERT_EQUAL_INT(1, compressed->words);
+    TEST_ASSERT_EQUAL_INT(0xa, compressed->planes[0]); /* signs */
+    TEST_ASSERT_EQUAL_INT(0xb, compressed->planes[1]); /* weights 3, 3, 1, 3 */
+    pack_signs(query, hv, compressed);
+    TEST_ASSERT_EQUAL_INT(0, search_compressed(compressed, query, 1,
+                                               &prediction));
+    TEST_ASSERT_EQUAL_FLOAT(-2.0 / (2.0 * sqrt(28.0)),
+                            prediction.similarities[0]);
+    hdcdeinit_compressed(compressed);
+}
+
+void test_hdc_compress_prune()
+{
+    double am0[] = { 1.0, 1.0, 1.0, 1.0, 1.0, -1.0, 1.0, -1.0 };
+    double am1[] = { 1.0, 1.0, 1.0, 1.0, -1.0, 1.0, -1.0, 1.0 };
+    double* am[] = { am0, am1 };
+    int dims[] = { 4, 5, 6, 7 };
+    struct hdc_trained_model model = { NULL, am, 2, NULL };
+    struct hdc_compressed_model* compressed = hdccompress(&model, 8, 1, 0.5);
+    uint64_t query[1];
+    struct hdc_prediction prediction;
+    TEST_ASSERT_EQUAL_INT(4, compressed->num_dims);
+    TEST_ASSERT_EQUAL_INT_ARRAY(dims, compressed->dims, 4);
+    pack_signs(query, am1, compressed);
+    TEST_ASSERT_EQUAL_INT(1, search_compressed(compressed, query, 2,
+                                               &prediction));
+    TEST_ASSERT_EQUAL_INT(2, prediction.k);
+    TEST_ASSERT_EQUAL_FLOAT(2.0, prediction.margin); /* cos 1 against -1 */
+    hdcdeinit_compressed(compressed);
+
+    /* Equal variances keep the lowest dimensions */
+    double tie0[] = { 1.0, -1.0, 1.0, -1.0, 1.0, -1.0, 1.0, -1.0 };
+    double tie1[] = { -1.0, 1.0, -1.0, 1.0, -1.0, 1.0, -1.0, 1.0 };
+    double* tie[] = { tie0, tie1 };
+    int tie_dims[] = { 0, 1, 2, 3 };
+    model.am = tie;
+    compressed = hdccompress(&model, 8, 1, 0.5);
+    TEST_ASSERT_EQUAL_INT_ARRAY(tie_dims, compressed->dims, 4);
+    hdcdeinit_compressed(compressed);
+}
+
+void test_hdc_index()
+{
+    int len = 256;
+    int num_classes = 32;
+    double* am[32];
+    int seen[32] = { 0 };
+    srand(2);
+    for (int c = 0; c < num_classes; c++)
+    {
+        am[c] = malloc(len * sizeof(double));
+        gen_random_hv(am[c], len);
+    }
+    struct hdc_trained_model model = { NULL, am, num_classes, NULL };
+    struct hdc_compressed_model* compressed = hdccompress(&model, len, 1, 1.0);
+    struct hdc_am_index* index = hdcindex(compressed, 4, 3);
+    int probes[4];
+    int distances[4];
+    uint64_t query[4];
+    struct hdc_prediction prediction;
+
+    TEST_ASSERT_EQUAL_INT(num_classes, index->list_offsets[4]);
+    for (int i = 0; i < num_classes; i++)
+    {
+        seen[index->list_labels[i]]++;
+    }
+    for (int c = 0; c < num_classes; c++)
+    {
+        TEST_ASSERT_EQUAL_INT(1, seen[c]);
+        pack_signs(query, am[c], compressed);
+        /* Probing every list is exhaustive */
+        TEST_ASSERT_EQUAL_INT(c, search_index(index, query, 4, probes,
+                                              distances, 1, &prediction));
+    }
+
+    hdcdeinit_index(index);
+    hdcdeinit_compressed(compressed);
+    for (int c = 0; c < num_classes; c++)
+    {
+        free(am[c]);
+    }
+}
+
+void test_hdc_sparse_bind()
+{
+    uint16_t a[] = { 0, 3, 7, 5 };
+    uint16_t b[] = { 1, 6, 7, 0 };
+    uint16_t c[] = { 1, 1, 6, 5 };
+    uint16_t d[4];
+    sparse_bind(d, a, b, 4, 8);
+    TEST_ASSERT_EQUAL_MEMORY(c, d, sizeof(d));
+}
+
+void test_hdc_sparse_bundle_similarity()
+{
+    int counts[3 * 4] = { 0 };
+    double norm_sq = 0.0;
+    uint16_t a[] = { 0, 1, 2 };
+    uint16_t b[] = { 0, 3, 2 };
+    TEST_ASSERT_TRUE(isnan(sparse_similarity(counts, norm_sq, a, 3, 4)));
+    sparse_bundle(counts, &norm_sq, a, 3, 4);
+    sparse_bundle(counts, &norm_sq, b, 3, 4);
+    TEST_ASSERT_EQUAL_INT(2, counts[0]);
+    TEST_ASSERT_EQUAL_INT(1, counts[4 + 3]);
+    TEST_ASSERT_EQUAL_FLOAT(10.0, norm_sq); /* 2^2 + 1^2 + 1^2 + 2^2 */
+    TEST_ASSERT_EQUAL_FLOAT(5.0 / (sqrt(10.0) * sqrt(3.0)),
+                            sparse_similarity(counts, norm_sq, a, 3, 4));
+}
+
+void test_hdc_sparse_record()
+{
+    uint16_t cim[] = { 0, 0, 0 };
+    uint16_t im[] = { 1, 2, 3, 1, 5, 6, 4, 4, 7 };
+    hdc_level_t levels[] = { 0, 0, 0 };
+    uint16_t record[3];
+    uint16_t expected[] = { 1, 5, 7 };
+    struct hdc_sparse_model model;
+    model.blocks = 3;
+    model.block_size = 8;
+    model.cim = cim;
+    model.cim_length = 1;
+    model.im = im;
+    model.im_length = 3;
+    /* Block 0 has a majority, blocks 1 and 2 are ties won by channels 1 and 2 */
+    sparse_record(record, levels, &model);
+    TEST_ASSERT_EQUAL_MEMORY(expected, record, sizeof(record));
+}
+
+void test_hdc_sparse_item_memories()
+{
+    struct hdc_sparse_model model;
+    model.blocks = 100;
+    model.block_size = 100;
+    model.im_length = 4;
+    model.cim_length = 22;
+    TEST_ASSERT_EQUAL_INT(0, init_sparse_item_memories(&model));
+    int first_last = 0;
+    int first_next = 0;
+    for (int b = 0; b < model.blocks; b++)
+    {
+        first_last += model.cim[b] == model.cim[21 * model.blocks + b];
+        first_next += model.cim[b] == model.cim[model.blocks + b];
+    }
+    /* The extremes must not overlap more than random vectors would */
+    TEST_ASSERT_TRUE(first_last <= model.blocks / model.block_size);
+    /* Neighbouring levels differ in about BLOCKS / MAXL blocks */
+    TEST_ASSERT_EQUAL_INT(model.blocks - model.blocks / 21, first_next);
+    free(model.cim);
+    free(model.im);
+}
+
+void test_hdc_classifier_matches_predict()
+{
+    enum { len = 400, D = 1000, N = 3, maxl = 21, classes = 4 };
+    static int labels[len];
+    static double rows[len][HDC_DATASET_CHANNELS];
+    static double* samples[len];
+    static int predicted[4][len - N + 1];
+    struct hdc_classifier* classifiers[4];
+    struct hdc_prediction prediction;
+    for (int i = 0; i < len; i++)
+    {
+        samples[i] = rows[i];
+    }
+    hdc_gen_dataset(labels, samples, len, classes, maxl, 3, 3);
+    struct hdc_trained_model* model =
+        hdctrain(labels, samples, len, classes, D, N, maxl, 1.0, 0.9);
+    struct hdc_compressed_model* compressed = hdccompress(model, D, 2, 1.0);
+    struct hdc_am_index* index = hdcindex(compressed, 2, 3);
+    struct hdc_sparse_model* sparse =
+        hdctrain_sparse(labels, samples, len, classes, 50, 50, N, maxl, 1.0,
+                        0.9);
+    struct hdc_accuracy expected[4];
+    expected[0] =
+        predict_dense(model, labels, samples, len, D, N, 1.0, predicted[0]);
+    expected[1] = predict_packed(compressed, NULL, 0, labels, samples, len, N,
+                                 1.0, predicted[1]);
+    expected[2] = predict_packed(compressed, index, 1, labels, samples, len,
+                                 N, 1.0, predicted[2]);
+    expected[3] =
+        predict_sparse(sparse, labels, samples, len, N, 1.0, predicted[3]);
+    classifiers[0] = hdcclassifier(model, D, N);
+    classifiers[1] = hdcclassifier_compressed(compressed, N);
+    classifiers[2] = hdcclassifier_indexed(index, 1, N);
+    classifiers[3] = hdcclassifier_sparse(sparse, N);
+
+    /* Every model kind reports the batch label with a margin */
+    for (int c = 0; c < 4; c++)
+    {
+        TEST_ASSERT_NOT_NULL(classifiers[c]);
+        for (int i = 0; i < len - N + 1; i++)
+        {
+            TEST_ASSERT_EQUAL_INT(predicted[c][i],
+                                  hdcclassify(classifiers[c], samples + i, 1.0,
+                                              2, 0.0, &prediction));
+            TEST_ASSERT_TRUE(prediction.margin >= 0.0);
+        }
+        struct hdc_accuracy actual = hdcpredict_classifier(
+            classifiers[c], labels, samples, len, 1.0);
+        TEST_ASSERT_EQUAL_INT(expected[c].num_tests, actual.num_tests);
+        TEST_ASSERT_EQUAL_INT(expected[c].correct, actual.correct);
+        TEST_ASSERT_EQUAL_INT(expected[c].tranz_error, actual.tranz_error);
+        TEST_ASSERT_EQUAL_INT(expected[c].out_of_range, actual.out_of_range);
+        hdcdeinit_classifier(classifiers[c]);
+    }
+
+    hdcdeinit_sparse(sparse);
+    hdcdeinit_index(index);
+    hdcdeinit_compressed(compressed);
+    hdcdeinit(model);
+}
+
+#ifdef HDC_STATIC_PROFILE
+void test_hdc_static_import()
+{
+    enum { len = 500, D = 1000, N = 3, maxl = 21, classes = 3 };
+    static uint64_t arena[8192];
+    static int labels[len];
+    static double rows[len][HDC_DATASET_CHANNELS];
+    static double* samples[len];
+    static hdc_level_t levels[len * HDC_DATASET_CHANNELS];
+    static uint8_t window_levels[len * HDC_DATASET_CHANNELS];
+    static int predicted[len - N + 1];
+    for (int i = 0; i < len; i++)
+    {
+        samples[i] = rows[i];
+    }
+    hdc_gen_dataset(labels, samples, len, classes, maxl, 7, 2);
+    struct hdc_trained_model* trained =
+        hdctrain(labels, samples, len, classes, D, N, maxl, 1.0, 0.9);
+    TEST_ASSERT_NOT_NULL(trained);
+    predict_dense(trained, labels, samples, len, D, N, 1.0, predicted);
+
+    struct hdc_static_model model;
+    TEST_ASSERT_TRUE(hdc_required_memory(D, N, HDC_DATASET_CHANNELS, classes,
+                                         maxl + 1) <= sizeof(arena));
+    TEST_ASSERT_EQUAL_INT(-1, hdc_static_import(&model, (char*)arena + 4,
+                                                sizeof(arena) - 4, trained,
+                                                D, N));
+    TEST_ASSERT_EQUAL_INT(0, hdc_static_import(&model, arena, sizeof(arena),
+                                               trained, D, N));
+
+    /* The deployed model must predict every window like the host model */
+    quantize_block(levels, samples, len, HDC_DATASET_CHANNELS, 1.0, maxl + 1);
+    for (int i = 0; i < len * HDC_DATASET_CHANNELS; i++)
+    {
+        window_levels[i] = (uint8_t)levels[i];
+    }
+    for (int i = 0; i < len - N + 1; i++)
+    {
+        TEST_ASSERT_EQUAL_INT(predicted[i], hdc_static_predict(
+            &model, window_levels + i * HDC_DATASET_CHANNELS, NULL));
+    }
+    hdcdeinit(trained);
+}
+#endif
+
 int main(int argc, char* argv[])
 {
     UNITY_BEGIN();
@@ -73,5 +464,22 @@ int main(int argc, char* argv[])
     RUN_TEST(test_hdc_entrywise_sum);
     RUN_TEST(test_hdc_cos_angle);
     RUN_TEST(test_hdc_circ_shift);
+    RUN_TEST(test_hdc_quantize_block);
+    RUN_TEST(test_hdc_select_kernels_fallback);
+    RUN_TEST(test_hdc_fixed_kernels_match_generic);
+    RUN_TEST(test_hdc_search_top_k);
+    RUN_TEST(test_hdc_classify_reject);
+    RUN_TEST(test_hdc_classifier_matches_predict);
+    RUN_TEST(test_hdc_popcount64);
+    RUN_TEST(test_hdc_compress_bit_planes);
+    RUN_TEST(test_hdc_compress_prune);
+    RUN_TEST(test_hdc_index);
+    RUN_TEST(test_hdc_sparse_bind);
+    RUN_TEST(test_hdc_sparse_bundle_similarity);
+    RUN_TEST(test_hdc_sparse_record);
+    RUN_TEST(test_hdc_sparse_item_memories);
+#ifdef HDC_STATIC_PROFILE
+    RUN_TEST(test_hdc_static_import);
+#endif
     return UNITY_END();
 }